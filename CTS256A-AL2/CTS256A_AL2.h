@@ -30,8 +30,10 @@
 #include "SystemConsole.h"
 #include "RAM.h"
 #include "ROM.h"
-#include "InOut_I.h"
+#include "CTS256A_AL2_Data_InOut.h"
+#include "CTS256A_AL2_HLE.h"
 #include "TMS7000CPU.h"
+#include "TMS7000Core.h"
 #include "TMS7000Disassembler.h"
 #include "ConIOConsole.h"
 
@@ -39,103 +41,80 @@
 #include <vector>
 #include <cstring>
 
-// Number of READs after last input/output before entering DEBUG mode
-#define DEBUG_CTR_RELOAD 999999
-
-// Number of READs after eof and last output before stopping the emulation
-#define EOF_CTR_RELOAD 199999
-
-class CTS256A_AL2_Data_InOut
-	: public Memory_I, public InOut_I
+class CTS256A_AL2 : public System_I
 {
 public:
-	CTS256A_AL2_Data_InOut( TMS7000CPU &cpu, std::istream &istr,
-		std::ostream &ostr,	std::vector<uchar>&& exception_rom,
-		ushort rom_address )
-	: cpu_( cpu ), istr_( istr ), ostr_( ostr ), exception_rom_( exception_rom ),
-		rom_address_( rom_address ), bport_( 0 ), initctr_( 6 ), irq3ctr_( 0 ),
-		eof_( false ), debug_( false ),	debug_rules_( false ), verbose_( false ),
-		echo_( false ), noOK_( false ),	mode_( 'T' ), debugctr_( DEBUG_CTR_RELOAD )
+	// Machine snapshot, taken at the first input poll after the init. The
+	// snapshot files of main.cpp save it field by field, with a version:
+	// update them with the CPU and board state fields.
+	struct snapshot_t
 	{
-		memset( ram_, 0, 0x800 );
-	}
+		TMS7000CPU::state_t				cpu;
+		CTS256A_AL2_Board_I::state_t	data;
+	};
 
-	uchar read( ushort addr );
-
-	uchar write( ushort addr, uchar data );
-
-    reader_t getReader()
-	{
-		return 0;
-	}
+	// Create the system, with the diagnostic board (debug watchdog, traces)
+	// for -d, -r, -v and -e, else with the release board
+	static CTS256A_AL2 *create( bool diagnostic, std::istream &istr, std::ostream &ostr,
+		std::vector<uchar>&& exception_rom, ushort rom_address );
 
-    writer_t getWriter()
-	{
-		return 0;
-	}
+	// Run the ROM init up to the first input poll; run() then goes on from there
+	virtual void boot() = 0;
 
-    void* getObject()
-	{
-		return 0;
-	}
+	// Get the machine snapshot, after boot()
+	virtual void getSnapshot( snapshot_t &snapshot ) = 0;
 
-	// out char
-	virtual uchar out( ushort addr, uchar data );
+	// Restore a machine snapshot, for run() to go on from there;
+	// fails if the snapshot was taken with another exception ROM
+	virtual bool restore( const snapshot_t &snapshot ) = 0;
 
-	// in char
-	virtual uchar in( ushort addr );
+	virtual void setOption( uchar option, uint value ) = 0;
 
-	void setOption( uchar option, uint value );
+	// Get number of emulated instructions
+	virtual ulong getInstructions() = 0;
 
-	uint getOption( uchar option );
+	// Get number of emulated cycles
+	virtual ulong getCycles() = 0;
 
-	void debug_rule();
+	// Get number of utterances (input lines)
+	virtual uint getUtterances() = 0;
 
-private:
-	uchar					bport_;
-	TMS7000CPU				&cpu_;
-	uchar					ram_[0x800];
-	std::istream			&istr_;
-	std::ostream			&ostr_;
-	std::vector<uchar>      exception_rom_;
-	ushort                  rom_address_;
-	uchar					initctr_;
-	ushort					irq3ctr_;
-	uint					debugctr_;
-	uint					eofctr_;
-	bool					eof_;
-	bool					debug_;
-	bool					debug_rules_;
-	bool					verbose_;
-	bool					echo_;
-	bool					textMode_;
-	bool					noOK_;
-	char					mode_;
-	char					initial_;
+	// Get the ROM subroutines run natively, with their statistics
+	virtual const CTS256A_AL2_HLE &getHLE() const = 0;
 };
 
-
-class CTS256A_AL2 : public System_I
+// The system on the board of the Policy
+template<class Policy>
+class CTS256A_AL2_System : public CTS256A_AL2
 {
 public:
-	CTS256A_AL2( std::istream &istr, std::ostream &ostr,
+	CTS256A_AL2_System( std::istream &istr, std::ostream &ostr,
 		std::vector<uchar>&& exception_rom, ushort rom_address )
-	: debug_( false ), istr_( istr), ostr_( ostr ),
-		data_( cpu_, istr, ostr, std::move( exception_rom ), rom_address )
+	: debug_( false ), recompiled_( false ), booted_( false ), istr_( istr), ostr_( ostr ),
+		data_( cpu_, istr, ostr, std::move( exception_rom ), rom_address ),
+		hle_( cpu_, data_ )
 	{
 		systemConsole_.setSystem( this );
 		systemConsole_.setConsole( &console_ );
-		cpu_.setExtMemory( &data_ );
-		cpu_.setExtInOut( &data_ );
+		cpu_.setBus( &data_ );
 		cpu_.setConsole( &systemConsole_ );
 		cpu_.setMode( &mode_ );
 		disass_.setCode( &data_ );
+
+		// The CTS256A-AL2 ROM and the exception ROM are immutable code
+		cpu_.addCodeCache( 0xF000, 0x1000 );
+		if ( data_.getRomSize() )
+			cpu_.addCodeCache( data_.getRomAddress(),
+				data_.getRomSize() < 0x1000 ? data_.getRomSize() : 0x1000 );
 	}
 
-	~CTS256A_AL2(void)
+	~CTS256A_AL2_System(void)
 	{
 	}
 
+	void boot();
+	void getSnapshot( snapshot_t &snapshot );
+	bool restore( const snapshot_t &snapshot );
 	void run();
 	void stop();
 	void exit();
@@ -146,19 +125,70 @@ public:
 
 	void setOption( uchar option, uint value )
 	{
+		if ( option == 'C' )
+		{
+			// Run the recompiled ROM code
+			recompiled_ = value != 0;
+			return;
+		}
+
+		if ( option == 'G' )
+		{
+			// Compile the code run more than value times to native code
+			cpu_.setJitThreshold( value );
+			return;
+		}
+
+		if ( option == 'W' )
+		{
+			// Interpret the idle loops instead of skipping them
+			cpu_.setIdleSkip( value == 0 );
+			return;
+		}
+
+		if ( option == 'H' )
+		{
+			// Run the ROM subroutines of value (HLE_* mask) natively
+			hle_.setRoutines( value );
+			return;
+		}
+
 		data_.setOption( option, value );
 		if ( option == 'D' )
 			debug_ = value != 0;
 	}
 
+	ulong getInstructions()
+	{
+		return cpu_.getInstructions();
+	}
+
+	ulong getCycles()
+	{
+		return cpu_.getCycles();
+	}
+
+	uint getUtterances()
+	{
+		return data_.getUtterances();
+	}
+
+	const CTS256A_AL2_HLE &getHLE() const
+	{
+		return hle_;
+	}
+
 private:
-	TMS7000CPU				cpu_;
-	CTS256A_AL2_Data_InOut	data_;
+	TMS7000Core<CTS256A_AL2_Data_InOut<Policy>>	cpu_;
+	CTS256A_AL2_Data_InOut<Policy>	data_;
+	CTS256A_AL2_HLE			hle_;
 	Mode					mode_;
 	ConIOConsole			console_;
 	SystemConsole			systemConsole_;
 	TMS7000Disassembler		disass_;
 	bool					debug_;
+	bool					recompiled_;
+	bool					booted_;
 	std::istream			&istr_;
 	std::ostream			&ostr_;
 };
@@ -0,0 +1,951 @@
+/*
+    CTS256A-AL2 - CTS256A-AL2 Board Memory and I/O.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "CTS256A_AL2_Data_InOut.h"
+#include "CTS256A_AL2_ROM.h"
+
+#include <stdio.h>
+#include <ctype.h>
+
+static const char * SP0256_labels[] =
+{
+	"PA1",	"PA2",	"PA3",	"PA4",	"PA5",	"OY",	"AY",	"EH",
+	"KK3",	"PP",	"JH",	"NN1",	"IH",	"TT2",	"RR1",	"AX",
+	"MM",	"TT1",	"DH1",	"IY",	"EY",	"DD1",	"UW1",	"AO",
+	"AA",	"YY2",	"AE",	"HH1",	"BB1",	"TH",	"UH",	"UW2",
+	"AW",	"DD2",	"GG3",	"VV",	"GG1",	"SH",	"ZH",	"RR2",
+	"FF",	"KK2",	"KK1",	"ZZ",	"NG",	"LL",	"WW",	"XR",
+	"WH",	"YY1",	"CH",	"ER1",	"ER2",	"OW",	"DH2",	"SS",
+	"NN2",	"HH2",	"OR",	"AR",	"YR",	"GG2",	"EL",	"BB2"
+};
+
+/* Patterns:
+#	09	One or more vowels
+.	0A	Voiced consonant: B D G J L M N R V W X
+%	0B	Suffix: -ER(S) -E -ES -ED -ELY -ING -OR -MENT
+&	0C	Sibilant: S C G Z X J CH SH
+@	0D	T S R D L Z N J TH CH SH preceding long U
+^	0E	One consonant
++	0F	Front vowel: E I Y
+:	10	Zero or more consonants
+*	11	One or more consonants
+>	12	Back vowel: O U
+<	13	Anything other than a letter
+?	14	Two or more vowels
+$	1F	Not a pattern symbol, ignored by the ROM
+		Should probably be a D: [I]D% = [AY] instead of [I]$% = [AY]
+*/
+
+static const char symbols[] =
+{
+	 0,		 0,		 0,		 0,		 0,		 0,		 0,		'\'',	// 00-07
+	 0,		'#',	'.',	'%',	'&',	'@',	'^',	'+',	// 08-0F
+	':',	'*',	'>',	'<',	'?',	 0,		 0,		 0,		// 10-17
+	 0,		 0,		 0,		 0,		 0,		 0,		 0,		'$',	// 18-1F
+	 0,		'A',	'B',	'C',	'D',	'E',	'F',	'G',	// 20-27
+	'H',	'I',	'J',	'K',	'L',	'M',	'N',	'O',	// 28-2F
+	'P',	'Q',	'R',	'S',	'T',	'U',	'V',	'W',	// 30-37
+	'X',	'Y',	'Z',	 0,		 0,		 0,		 0,		 0		// 38-3F
+};
+
+
+template<class Policy>
+uchar CTS256A_AL2_Data_InOut<Policy>::read( ushort addr )
+{
+	cpu_.TMS7000CPU::trigIRQ( 0x02 ); // trig INT1 - output interrupt
+
+	if ( isHooked( addr ) )
+		callHooks( addr );
+
+	if ( !eof_ )
+	{
+		if ( watchdog_.expired() ) {
+			cpu_.setMode( MODE_STOP );
+			cpu_.printf( "\nCTS256A_AL2 debugctr stopped at %04X\n", addr );
+		}
+	}
+	else if ( cpu_.getMode() != MODE_EXIT && !--eofctr_ )
+	{
+		// EOF watchdog, unless the end of input was found
+		if ( isDebug() )
+			cpu_.printf( "\nCTS256A_AL2 eofctr stopped at %04X\n", addr );
+		cpu_.setMode( isDebug() ? MODE_STOP : MODE_EXIT );
+	}
+
+	const uchar *page = readPages_[addr >> 8];
+
+	if ( page )
+		return page[addr & 0xFF];
+
+	return ( this->*readHandlers_[addr >> 8] )( addr );
+}
+
+// Register a hook at addr
+template<class Policy>
+void CTS256A_AL2_Data_InOut<Policy>::addHook( ushort addr, hook_t hook, void *object )
+{
+	hooks_.push_back( { addr, hook, object } );
+	hookMap_[addr >> 5] |= 1u << ( addr & 0x1F );
+}
+
+// Unregister a hook at addr
+template<class Policy>
+void CTS256A_AL2_Data_InOut<Policy>::removeHook( ushort addr, hook_t hook, void *object )
+{
+	bool hooked = false;
+
+	for ( auto it = hooks_.begin(); it != hooks_.end(); )
+	{
+		if ( it->addr == addr && it->hook == hook && it->object == object )
+		{
+			it = hooks_.erase( it );
+		}
+		else
+		{
+			hooked |= it->addr == addr;
+			++it;
+		}
+	}
+
+	if ( !hooked )
+		hookMap_[addr >> 5] &= ~( 1u << ( addr & 0x1F ) );
+}
+
+// Call the hooks registered at addr
+template<class Policy>
+void CTS256A_AL2_Data_InOut<Policy>::callHooks( ushort addr )
+{
+	for ( const hookentry_t &entry : hooks_ )
+	{
+		if ( entry.addr == addr )
+			entry.hook( entry.object, addr );
+	}
+}
+
+template<class Policy>
+void CTS256A_AL2_Data_InOut<Policy>::pollHook( void *object, ushort addr )
+{
+	( (CTS256A_AL2_Data_InOut*)object )->pollInput( addr );
+}
+
+// POLL/ENDPOL: trigger INT3 if the output buffer is empty, or end the
+// conversion after EOF when all is done
+template<class Policy>
+void CTS256A_AL2_Data_InOut<Policy>::pollInput( ushort addr )
+{
+	if ( !eof_ )
+	{
+		if ( !initctr_ && ( bport_ & 0x01 ) ) {
+			// POLL/ENDPOL and output buffer empty
+			if ( cpu_.getdata(7) == cpu_.getdata(9) ) {
+				if ( flush_ == FLUSH_LINE && outputSize_ )
+					flushOutput();
+				if ( addr == 0xF10C && !charInput_ && !isVerbose() )
+					injectInput();
+				cpu_.TMS7000CPU::trigIRQ( 0x08 ); // trig INT3 - input interrupt
+				if ( isVerbose() )
+					cpu_.printf( " %04x 7:%d 9:%d TRIG\n", addr, cpu_.getdata(7), cpu_.getdata(9) );
+			} else {
+				if ( isVerbose() )
+					cpu_.printf( " %04x 7:%d 9:%d NOTRIG\n", addr, cpu_.getdata(7), cpu_.getdata(9) );
+			}
+		}
+	}
+	else if ( isDone() )
+	{
+		// Waiting for input after EOF, all allophones output
+		if ( isDebug() )
+			cpu_.printf( "\nCTS256A_AL2 end of input at %04X\n", addr );
+		cpu_.setMode( isDebug() ? MODE_STOP : MODE_EXIT );
+	}
+}
+
+template<class Policy>
+void CTS256A_AL2_Data_InOut<Policy>::rulesHook( void *object, ushort addr )
+{
+	CTS256A_AL2_Data_InOut *data = (CTS256A_AL2_Data_InOut*)object;
+
+	if ( addr == 0xF406 )
+	{
+		// after CALL @SELRUL
+		// got the initial in the accumulator
+		data->initial_ = data->cpu_.read( 0 );
+	}
+	else
+	{
+		// after BTJO %>10,R10,LF47A
+		// found matching rule in R20:R21
+		data->debug_rule();
+	}
+}
+
+// Read without side effects, used to decode code and by the debugger
+template<class Policy>
+uchar CTS256A_AL2_Data_InOut<Policy>::peek( ushort addr )
+{
+	const uchar *page = readPages_[addr >> 8];
+
+	if ( page )
+		return page[addr & 0xFF];
+
+	if ( readHandlers_[addr >> 8] == &CTS256A_AL2_Data_InOut::readExceptionRom )
+		return readExceptionRom( addr );
+
+	// 0x0200-0x0FFF: Parallel data (in)
+	return 0xFF;
+}
+
+// Skip the repeated opcode fetches of an idle loop at addr, as many as read()
+// would do without any visible effect: up to the read expiring the debug
+// watchdog (diagnostic board) or the EOF counter, and none in the POLL loops
+// when it would trigger INT3.
+// Returns the number of reads skipped.
+template<class Policy>
+ulong CTS256A_AL2_Data_InOut<Policy>::skipIdle( ushort addr )
+{
+	// The hooks see every fetch, but the POLL/ENDPOL ones below
+	if ( isHooked( addr ) && !isPollAddress( addr ) )
+		return 0;
+
+	if ( !eof_ )
+	{
+		if ( isInputPoll( addr ) ||
+			( isVerbose() && !initctr_ && ( bport_ & 0x01 ) && isPollAddress( addr ) ) )
+			return 0;
+		return watchdog_.skipIdle();
+	}
+
+	if ( eofctr_ <= 1 )
+		return 0;
+
+	ulong skipped = eofctr_ - 1;
+	eofctr_ = 1;
+	return skipped;
+}
+
+// Check if the fetch at addr polls for input: POLL/ENDPOL and output buffer
+// empty, after the init
+template<class Policy>
+bool CTS256A_AL2_Data_InOut<Policy>::isInputPoll( ushort addr )
+{
+	return !eof_ && !initctr_ && ( bport_ & 0x01 ) && isPollAddress( addr )
+		&& cpu_.getdata(7) == cpu_.getdata(9);
+}
+
+// Get the board state
+template<class Policy>
+void CTS256A_AL2_Data_InOut<Policy>::getState( state_t &state )
+{
+	memcpy( state.ram, ram_, sizeof state.ram );
+	state.bport = bport_;
+	state.initctr = initctr_;
+	state.irq3ctr = irq3ctr_;
+	state.debugctr = watchdog_.getCounter();
+	state.eofctr = eofctr_;
+	state.eof = eof_;
+	state.utterances = utterances_;
+	state.lastInput = lastInput_;
+	memcpy( state.initOutput, initOutput_, sizeof state.initOutput );
+	state.romAddress = rom_address_;
+	state.romSize = getRomSize();
+	state.romChecksum = romChecksum_;
+}
+
+// Set the board state, and output the init allophones again, unless
+// suppressed; fails if the exception ROM differs
+template<class Policy>
+bool CTS256A_AL2_Data_InOut<Policy>::setState( const state_t &state )
+{
+	if ( state.romSize != getRomSize() ||
+		( state.romSize && ( state.romAddress != rom_address_ || state.romChecksum != romChecksum_ ) ) )
+		return false;
+
+	memcpy( ram_, state.ram, sizeof ram_ );
+	bport_ = state.bport;
+	initctr_ = state.initctr;
+	irq3ctr_ = state.irq3ctr;
+	watchdog_.setCounter( state.debugctr );
+	eofctr_ = state.eofctr;
+	eof_ = state.eof;
+	utterances_ = state.utterances;
+	lastInput_ = state.lastInput;
+	memcpy( initOutput_, state.initOutput, sizeof initOutput_ );
+
+	// New input from the start
+	resetInput();
+
+	if ( !noOK_ )
+	{
+		for ( uint i = 0; i < uint( INIT_CTR - initctr_ ); ++i )
+			putAllophone( initOutput_[i] );
+	}
+
+	return true;
+}
+
+// Compute the checksum of the exception ROM
+template<class Policy>
+uint CTS256A_AL2_Data_InOut<Policy>::getRomChecksum()
+{
+	uint sum = 0;
+
+	for ( uchar byte : exception_rom_ )
+		sum = sum * 31 + byte;
+
+	return sum;
+}
+
+template<class Policy>
+uchar CTS256A_AL2_Data_InOut<Policy>::write( ushort addr, uchar data )
+{
+	uchar *page = writePages_[addr >> 8];
+
+	if ( page )
+		return page[addr & 0xFF] = data;
+
+	return ( this->*writeHandlers_[addr >> 8] )( addr, data );
+}
+
+// Build the page table of the memory map
+template<class Policy>
+void CTS256A_AL2_Data_InOut<Policy>::mapMemory()
+{
+	static const uchar zeros[0x100] = { 0 };
+
+	memset( ones_, 0xFF, sizeof ones_ );
+
+	for ( uint page = 0; page < 0x100; ++page )
+	{
+		readPages_[page] = ones_;
+		writePages_[page] = sink_;
+		readHandlers_[page] = 0;
+		writeHandlers_[page] = 0;
+	}
+
+	// 0x0200-0x0FFF: Parallel data (in)
+	for ( uint page = 0x00; page < 0x10; ++page )
+	{
+		readPages_[page] = 0;
+		readHandlers_[page] = &CTS256A_AL2_Data_InOut::readInput;
+	}
+
+	// 0x1000-0x1FFF: UART Parameters (in)
+	for ( uint page = 0x10; page < 0x20; ++page )
+		readPages_[page] = zeros;
+
+	// 0x2000-0x2FFF: SP0256 (out)
+	for ( uint page = 0x20; page < 0x30; ++page )
+	{
+		writePages_[page] = 0;
+		writeHandlers_[page] = &CTS256A_AL2_Data_InOut::writeSP0256;
+	}
+
+	// 0x3000-0x37FF: RAM (in/out)
+	for ( uint page = 0x30; page < 0x38; ++page )
+	{
+		readPages_[page] = writePages_[page] = ram_ + ( ( page - 0x30 ) << 8 );
+	}
+
+	// 0x5000-0xEFFF: Exception ROM (in); the partial pages and the byte after
+	// its end go through the handler
+	if ( !exception_rom_.empty() )
+	{
+		uint end = rom_address_ + uint( exception_rom_.size() );
+		for ( uint page = rom_address_ >> 8; page <= ( end >> 8 ); ++page )
+		{
+			if ( page < 0x50 || page >= 0xF0 )
+				continue;
+
+			if ( ( page + 1 ) << 8 <= end )
+			{
+				readPages_[page] = exception_rom_.data() + ( ( page << 8 ) & 0x0FFF );
+			}
+			else
+			{
+				readPages_[page] = 0;
+				readHandlers_[page] = &CTS256A_AL2_Data_InOut::readExceptionRom;
+			}
+		}
+	}
+
+	// 0xF000-0xFFFF: CTS256A-AL2 ROM (in)
+	for ( uint addr = 0; addr < 0x1000; ++addr )
+		rom_[addr] = CTS256A_AL2_readRom( 0xF000 + addr );
+
+	for ( uint page = 0xF0; page < 0x100; ++page )
+		readPages_[page] = rom_ + ( ( page - 0xF0 ) << 8 );
+}
+
+// 0x0200-0x0FFF: Parallel data (in)
+template<class Policy>
+uchar CTS256A_AL2_Data_InOut<Policy>::readInput( ushort /*addr*/ )
+{
+	if ( isVerbose() )
+	{
+		// What the stream has left: the input buffer, then the stream buffer
+		std::streamsize avail = istr_.rdbuf()->in_avail();
+		if ( inputPos_ < inputEnd_ )
+			avail = ( avail > 0 ? avail : 0 ) + ( inputEnd_ - inputPos_ );
+		cpu_.printf( " - avail %d:", int( avail ) );
+	}
+	int next = getInput();
+	if ( eof_ || next == EOF )
+	{
+		// last line without line end
+		if ( !eof_ && lastInput_ && lastInput_ != '\r' && lastInput_ != '\n' )
+			++utterances_;
+		eof_ = true;
+		eofctr_ = EOF_CTR_RELOAD;
+		if ( isVerbose() )
+			cpu_.printf( " in: EOF\n" );
+		return 0x0D;
+	}
+
+	uchar c = uchar( next );
+
+	if ( isVerbose() )
+		cpu_.printf( " in: %c\n", c );
+
+	// Stored by the INT3 handler (F1E2) at R4:R5
+	if ( offsets_enabled_ )
+		offsets_[getPointer( 5 ) & 0x7FF] = getInputOffset() - 1;
+
+	putInput( c );
+	return c;
+}
+
+// Empty the input buffer and forget the input offsets, for a new input
+template<class Policy>
+void CTS256A_AL2_Data_InOut<Policy>::resetInput()
+{
+	inputPos_ = inputEnd_ = 0;
+	inputOffset_ = 0;
+	allophoneOffset_ = lastOffset_ = INPUT_OFFSET_NONE;
+
+	for ( ulong &offset : offsets_ )
+		offset = INPUT_OFFSET_NONE;
+}
+
+// Read the next block of the input: what the stream has without blocking,
+// else 1 byte (console), and uppercase it as toupper() does in the C locale
+template<class Policy>
+bool CTS256A_AL2_Data_InOut<Policy>::fillInput()
+{
+	inputOffset_ += inputEnd_;
+	inputPos_ = inputEnd_ = 0;
+
+	// Stays at the end of the input, as istream::get()
+	if ( !istr_.good() )
+		return false;
+
+	std::streambuf *buf = istr_.rdbuf();
+	std::streamsize avail = buf->in_avail();
+	std::streamsize size = avail > INPUT_BUFFER_SIZE ? INPUT_BUFFER_SIZE : avail > 0 ? avail : 1;
+	std::streamsize n = avail < 0 ? 0 : buf->sgetn( (char*)input_, size );
+
+	if ( n <= 0 )
+	{
+		istr_.setstate( std::ios::eofbit | std::ios::failbit );
+		return false;
+	}
+
+	inputEnd_ = uint( n );
+
+	for ( uint i = 0; i < inputEnd_; ++i )
+	{
+		uchar c = input_[i];
+		input_[i] = uchar( c - ( uchar( c - 'a' ) < 26 ? 0x20 : 0 ) );
+	}
+
+	return true;
+}
+
+template<class Policy>
+void CTS256A_AL2_Data_InOut<Policy>::offsetsHook( void *object, ushort addr )
+{
+	CTS256A_AL2_Data_InOut *data = (CTS256A_AL2_Data_InOut*)object;
+	ulong *offsets = data->offsets_;
+
+	if ( addr == 0xF4B3 )
+	{
+		// CALL @F298 storing an allophone of the rule into the output buffer
+		// at R8:R9: the rule starts with the character read before R18:R19,
+		// in the input ring R40:R41..R42:R43
+		ushort ptr = data->getPointer( 19 );
+
+		if ( ptr == data->getPointer( 41 ) )
+			ptr = data->getPointer( 43 );
+
+		offsets[data->getPointer( 9 ) & 0x7FF] = offsets[( ptr - 1 ) & 0x7FF];
+	}
+	else
+	{
+		// CALL @F298 reading the next allophone to output at R6:R7 (INT1)
+		data->allophoneOffset_ = offsets[data->getPointer( 7 ) & 0x7FF];
+	}
+}
+
+// Account an input character: echo, utterances count
+template<class Policy>
+void CTS256A_AL2_Data_InOut<Policy>::putInput( uchar c )
+{
+	if ( Policy::diagnostic && echo_ )
+		cpu_.putch( c );
+
+	if ( c == '\r' || ( c == '\n' && lastInput_ != '\r' ) )
+		++utterances_;
+	lastInput_ = c;
+
+	watchdog_.reload();
+	++ioctr_;
+}
+
+// Result of CMP of 2 bytes, as tested by JP (N and Z clear) and JN (N set)
+static bool cmpPositive( uchar a, uchar b )
+{
+	uchar res = a - b;
+	return res && !( res & 0x80 );
+}
+
+static bool cmpNegative( uchar a, uchar b )
+{
+	return ( a - b ) & 0x80;
+}
+
+// Store the input directly into the input ring, instead of triggering INT3
+// once per character. Called at the fetch of F10C (waiting for a CR in R11
+// bit 4), where the INT3 handler stores each character with F1E2 and returns
+// to F10C; does the same as F1E2 for the plain characters, up to the CR.
+// Stops before the characters that F1E2 handles otherwise (ESC, ^R,
+// backspace), when the ring is filling up (flow control in F347), and at
+// EOF; these are left to INT3, triggered next.
+template<class Policy>
+void CTS256A_AL2_Data_InOut<Policy>::injectInput()
+{
+	uchar r11 = cpu_.getdata(11);
+
+	// INT3 from the parallel input taken at F10C: enabled, INT1 disabled,
+	// one utterance per line, not waiting for the ring to empty
+	if ( !( cpu_.getdata(10) & 0x80 ) || ( r11 & 0x31 )
+		|| !cpu_.getFlags().i || ( cpu_.in( 0 ) & 0x11 ) != 0x10 )
+		return;
+
+	ushort ptr = ( cpu_.getdata(4) << 8 ) | cpu_.getdata(5);
+	ushort free = ( cpu_.getdata(51) << 8 ) | cpu_.getdata(52);
+	ushort words = ( cpu_.getdata(56) << 8 ) | cpu_.getdata(57);
+	ushort end = ( cpu_.getdata(42) << 8 ) | cpu_.getdata(43);
+	ushort start = ( cpu_.getdata(40) << 8 ) | cpu_.getdata(41);
+
+	while ( !( r11 & 0x10 ) )
+	{
+		int next = peekInput();
+		if ( next == EOF )
+			break;
+
+		uchar c = uchar( next );
+		if ( c == 0x1B || c == 0x12 || c == 0x08 )
+			break;
+
+		// F347: flow control after the store. Under the high mark
+		// (R30:R31 bytes free), the input may be stopped: left to INT3
+		uchar hi = uchar( ( free - 1 ) >> 8 ), lo = uchar( free - 1 );
+		if ( !cmpPositive( hi, 0 ) && !cmpPositive( lo, 1 ) )
+			break;
+		if ( cmpNegative( hi, cpu_.getdata(30) ) ||
+			( !cmpPositive( hi, cpu_.getdata(30) ) && cmpNegative( lo, cpu_.getdata(31) ) ) )
+			break;
+
+		// F378: input enabled (INT3 enabled and DSR set)
+		r11 &= 0xDB;
+		out( 0x06, in( 0x06 ) | 0x01 );
+
+		getInput();
+		putInput( c );
+		if ( offsets_enabled_ )
+			offsets_[ptr & 0x7FF] = getInputOffset() - 1;
+
+		// F248: delimiters (not a letter, digit or quote) are stored with
+		// bit 7 set and counted as word ends; CR ends the utterance
+		if ( c != 0x27 && ( cmpPositive( c, 0x7B ) || cmpNegative( c, 0x30 )
+			|| ( !cmpNegative( c, 0x3A ) && cmpNegative( c, 0x41 ) ) ) )
+		{
+			if ( c == 0x0D )
+			{
+				r11 |= 0x10;
+				cpu_.write( 24, cpu_.getdata(2) );
+				cpu_.write( 25, cpu_.getdata(3) );
+			}
+			c |= 0x80;
+			++words;
+		}
+
+		// F298: store at R4:R5, wrapped from R42:R43 to R40:R41
+		cpu_.write( ptr, c );
+		if ( ++ptr == end )
+			ptr = start;
+		--free;
+	}
+
+	cpu_.write( 4, uchar( ptr >> 8 ) );
+	cpu_.write( 5, uchar( ptr ) );
+	cpu_.write( 51, uchar( free >> 8 ) );
+	cpu_.write( 52, uchar( free ) );
+	cpu_.write( 56, uchar( words >> 8 ) );
+	cpu_.write( 57, uchar( words ) );
+	cpu_.write( 11, r11 );
+}
+
+// 0x5000-0xEFFF: Exception ROM (in), partial pages
+template<class Policy>
+uchar CTS256A_AL2_Data_InOut<Policy>::readExceptionRom( ushort addr )
+{
+	if ( ( addr >= rom_address_ ) &&
+	     ( addr <= rom_address_ + exception_rom_.size() ) )
+	{
+		return exception_rom_[addr&0x0FFF];
+	}
+
+	return 0xFF;
+}
+
+// 0x2000-0x2FFF: SP0256 (out)
+template<class Policy>
+uchar CTS256A_AL2_Data_InOut<Policy>::writeSP0256( ushort /*addr*/, uchar data )
+{
+	if ( eof_ )
+	{
+		if ( isVerbose() )
+			cpu_.printf( "%5d ", eofctr_ );
+		eofctr_ = EOF_CTR_RELOAD;
+	}
+
+	if ( isVerbose() )
+		cpu_.printf( " SP0256: %02X=%s\n", data, data<0x40 ? SP0256_labels[data] : "**" );
+
+	if ( !noOK_ || !initctr_ )
+		putAllophone( data );
+
+	if ( initctr_ )
+		initOutput_[INIT_CTR - initctr_--] = data;
+
+	watchdog_.reload();
+	++ioctr_;
+
+	return data;
+}
+
+// Output an allophone
+template<class Policy>
+void CTS256A_AL2_Data_InOut<Policy>::putAllophone( uchar data )
+{
+	if ( allophoneWriter_ )
+	{
+		allophoneWriter_( allophoneObject_, data );
+		return;
+	}
+
+	if ( mode_ == 'T' )
+	{
+		char text[32];
+
+		// Input offset of the allophones from here
+		if ( offsets_enabled_ && allophoneOffset_ != lastOffset_ && allophoneOffset_ != INPUT_OFFSET_NONE )
+			putOutput( text, snprintf( text, sizeof text, " @%lu", allophoneOffset_ ) );
+		lastOffset_ = allophoneOffset_;
+
+		putOutput( " ", 1 );
+		putOutput( SP0256_labels[data], strlen( SP0256_labels[data] ) );
+	}
+	else
+	{
+		char code = char( data | 0x80 );
+		putOutput( &code, 1 );
+	}
+
+	if ( flush_ == FLUSH_ALLOPHONE || ( flush_ == FLUSH_WORD && data <= 0x04 ) )
+		flushOutput();
+}
+
+// Append to the output buffer, written when full
+template<class Policy>
+void CTS256A_AL2_Data_InOut<Policy>::putOutput( const char *text, size_t size )
+{
+	if ( outputSize_ + size > sizeof output_ )
+		writeOutput();
+
+	memcpy( output_ + outputSize_, text, size );
+	outputSize_ += size;
+}
+
+// Write the buffered output to the output stream, and flush it unless the
+// policy is FLUSH_EXIT
+template<class Policy>
+void CTS256A_AL2_Data_InOut<Policy>::flushOutput()
+{
+	if ( outputSize_ )
+		writeOutput();
+
+	if ( flush_ != FLUSH_EXIT )
+		ostr_.flush();
+}
+
+// Get the label of an allophone code
+const char *CTS256A_AL2_Board_I::getAllophoneLabel( uchar allophone )
+{
+	return SP0256_labels[allophone & 0x3F];
+}
+
+template<class Policy>
+uchar CTS256A_AL2_Data_InOut<Policy>::readAccessor( void *object, ushort addr )
+{
+	return ( (CTS256A_AL2_Data_InOut*)object )->read( addr );
+}
+
+template<class Policy>
+uchar CTS256A_AL2_Data_InOut<Policy>::writeAccessor( void *object, ushort addr, uchar data )
+{
+	return ( (CTS256A_AL2_Data_InOut*)object )->write( addr, data );
+}
+
+template<class Policy>
+uchar CTS256A_AL2_Data_InOut<Policy>::in( ushort addr )
+{
+	switch ( addr )
+	{
+	case 0x04:	// APORT (in)
+		// 7 (80)	Delimiter: 0=CR - 1=any
+		// 6 (40)	SCLK
+		// 5 (20)	RXD
+		// 4 (10)	RAM buffers: 0:internal(20in/26out) - 1:external(1792in/256out)
+		// 3 (08)	serial cfg: 0:7N2  - 1:selectable
+		// 2 (04)	m0 +	000:paral  - 001:50bd   - 010:110bd
+		// 1 (02)	m1 |==> 011:300bd  - 100:1200bd - 101:2400bd
+		// 0 (01)	m2 +    110:4800bd - 111:9600bd
+		return 0x10;
+	case 0x06:	// BPORT	(out) Port B data := xxxx xxxI (DSR/BUSY)
+		// 7 (80)	CLKOUT
+		// 6 (40)	ENABLE*
+		// 5 (20)	R/W*
+		// 4 (10)	ALATCH
+		// 3 (08)	TXD
+		// 2 (04)
+		// 1 (02)
+		// 0 (01)	DSR/BUSY
+		return 0xFF;
+	default:
+		return 0xFF;
+	}
+}
+
+template<class Policy>
+uchar CTS256A_AL2_Data_InOut<Policy>::out( ushort addr, uchar data )
+{
+	switch ( addr )
+	{
+	case 0x04:	// APORT (in)
+		// 7 (80)	Delimiter: 0=CR - 1=any
+		// 6 (40)	SCLK
+		// 5 (20)	RXD
+		// 4 (10)	RAM buffers: 0:internal(20in/26out) - 1:external(1792in/256out)
+		// 3 (08)	serial cfg: 0:7N2  - 1:selectable
+		// 2 (04)	m0 +	000:paral  - 001:50bd   - 010:110bd
+		// 1 (02)	m1 |==> 011:300bd  - 100:1200bd - 101:2400bd
+		// 0 (01)	m2 +    110:4800bd - 111:9600bd
+		return data;
+	case 0x06:	// BPORT	(out) Port B data := xxxx xxxI (DSR/BUSY)
+		// 7 (80)	CLKOUT
+		// 6 (40)	ENABLE*
+		// 5 (20)	R/W*
+		// 4 (10)	ALATCH
+		// 3 (08)	TXD
+		// 2 (04)
+		// 1 (02)
+		// 0 (01)	DSR/BUSY
+		bport_ = data;
+		return data;
+	default:
+		return data;
+	}
+}
+
+template<class Policy>
+void CTS256A_AL2_Data_InOut<Policy>::setOption( uchar option, uint value )
+{
+	switch( option )
+	{
+	case 'E':
+		echo_ = value != 0;
+		break;
+	case 'D':
+		debug_ = value != 0;
+		break;
+	case 'R':
+		removeHook( 0xF406, rulesHook, this );
+		removeHook( 0xF441, rulesHook, this );
+		debug_rules_ = value != 0;
+		if ( debug_rules_ )
+		{
+			addHook( 0xF406, rulesHook, this );
+			addHook( 0xF441, rulesHook, this );
+		}
+		break;
+	case 'V':
+		verbose_ = value != 0;
+		break;
+	case 'N':
+		noOK_ = value != 0;
+		break;
+	case 'M':
+		mode_ = (uchar)value;
+		break;
+	case 'K':
+		charInput_ = value != 0;
+		break;
+	case 'F':
+		flushOutput();
+		flush_ = char( value );
+		break;
+	case 'O':
+		removeHook( 0xF4B3, offsetsHook, this );
+		removeHook( 0xF393, offsetsHook, this );
+		offsets_enabled_ = value != 0;
+		if ( offsets_enabled_ )
+		{
+			addHook( 0xF4B3, offsetsHook, this );
+			addHook( 0xF393, offsetsHook, this );
+		}
+		break;
+	default:
+		cpu_.printf( "Unknown option %c=%d\n", option, value );
+	}
+}
+
+template<class Policy>
+uint CTS256A_AL2_Data_InOut<Policy>::getOption( uchar option )
+{
+	switch( option )
+	{
+	case 'E':
+		return echo_;
+	case 'D':
+		return debug_;
+	case 'R':
+		return debug_rules_;
+	case 'V':
+		return verbose_;
+	case 'N':
+		return noOK_;
+	case 'M':
+		return mode_;
+	case 'K':
+		return charInput_;
+	case 'F':
+		return flush_;
+	case 'O':
+		return offsets_enabled_;
+	default:
+		cpu_.printf( "Unknown option %c\n", option );
+		return 0;
+	}
+}
+
+template<class Policy>
+void CTS256A_AL2_Data_InOut<Policy>::debug_rule()
+{
+
+	ushort addr = ( cpu_.read( 20 ) << 8 ) + cpu_.read( 21 );
+
+	bool first = true;
+	bool allo = false;
+	bool bracket = false;
+	uchar c0 = initial_;
+
+	while ( true )
+	{
+		if ( first ) {
+			first = 0;
+			cpu_.printf( "%04X:\t", addr );
+		}
+
+		uchar c = cpu_.read( addr++ );
+
+		// Opening bracket ?
+		if ( c & 0x40 ) {
+			if ( allo ) {
+				cpu_.puts( " = " );
+			}
+			cpu_.putch( '[' );
+			if ( !allo && c0 >= 'A' )
+			{
+				cpu_.putch( c0 );
+			}
+			bracket = true;
+		}
+
+		uchar ch = c & 0x3F;
+
+		if ( !bracket )
+		{
+			uchar s = symbols[ch];
+			// pattern outside brackets: use symbols table
+			if ( s  )
+				cpu_.putch( s );
+			else
+				cpu_.printf( "{%02X}", ch );
+		}
+		else if ( allo )
+		{
+			// allophones inside brackets
+			if ( c != 0xFF )
+			{
+				cpu_.puts( SP0256_labels[ch] );
+				if ( !( c & 0x80 ) )
+					cpu_.putch( ' ' );
+			}
+		}
+		else
+		{
+			// pattern inside brackets
+			if ( c != 0xFF )
+				cpu_.putch( ch + 0x20  );
+		}
+
+		// Closing bracket ?
+		if ( c & 0x80 ) {
+			cpu_.putch( ']' );
+			if ( allo ) {
+				cpu_.putch( '\n' );
+				break; // done. Exit loop
+			}
+			allo = !allo;
+			bracket = 0;
+		}
+	}
+
+}
+
+// The boards of the release and diagnostic runs
+template class CTS256A_AL2_Data_InOut<CTS256A_AL2_Release>;
+template class CTS256A_AL2_Data_InOut<CTS256A_AL2_Diagnostic>;
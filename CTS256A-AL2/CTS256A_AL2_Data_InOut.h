@@ -0,0 +1,570 @@
+/*
+    CTS256A-AL2 - CTS256A-AL2 Board Memory and I/O.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Memory_I.h"
+#include "InOut_I.h"
+#include "TMS7000CPU.h"
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+
+// Number of READs after last input/output before entering DEBUG mode
+#define DEBUG_CTR_RELOAD 999999
+
+// Number of READs after eof and last output before stopping the emulation,
+// if the end of the conversion was not detected
+#define EOF_CTR_RELOAD 199999
+
+// Number of allophones output by the ROM initialization ("O.K.")
+#define INIT_CTR 6
+
+// Number of cycles run between checks of the debugger state
+#define RUN_CYCLES 10000
+
+// TMS7000 internal clock of the CTS256A-AL2 (Hz)
+#define CTS256A_AL2_CLOCK 5000000
+
+// Size of the input buffer, filled by blocks from the input stream
+#define INPUT_BUFFER_SIZE 0x10000
+
+// Input offset of the RAM bytes not coming from the input
+#define INPUT_OFFSET_NONE ulong( -1 )
+
+// Size of the allophone output buffer
+#define OUTPUT_BUFFER_SIZE 0x1000
+
+// Output flush policies (option 'F')
+#define FLUSH_ALLOPHONE 'A'		// after each allophone (interactive)
+#define FLUSH_WORD 'W'			// after each pause (PA1..PA5), between words
+#define FLUSH_LINE 'L'			// when all the input read so far is output
+#define FLUSH_EXIT 'E'			// when the buffer is full, and at the end
+
+// Board policies. The diagnostic one, selected by -d, -r, -v and -e, adds
+// the debug watchdog and the traces; the release one leaves them out of
+// read() and of the input and output paths. Both stop the emulation with
+// the EOF counter, which ends the conversions not detected as done.
+
+// Release board: a stalled ROM is not stopped, no traces
+class CTS256A_AL2_Release
+{
+public:
+	static const bool diagnostic = false;
+
+	// Account a read before EOF; true when the debug watchdog expires
+	bool expired()
+	{
+		return false;
+	}
+
+	// Check if n reads can be accounted without expiring the watchdog
+	bool canSkip( ulong /*n*/ ) const
+	{
+		return true;
+	}
+
+	// Account n reads
+	void skip( ulong /*n*/ )
+	{
+	}
+
+	// Account the reads of an idle loop up to the read expiring the
+	// watchdog; returns the number of reads
+	ulong skipIdle()
+	{
+		return 0;
+	}
+
+	// Restart the watchdog, after an input or an output
+	void reload()
+	{
+	}
+
+	uint getCounter() const
+	{
+		return DEBUG_CTR_RELOAD;
+	}
+
+	void setCounter( uint /*counter*/ )
+	{
+	}
+};
+
+// Diagnostic board: the debug watchdog enters the debugger after
+// DEBUG_CTR_RELOAD reads without input or output; traces of -v, -e and -d
+class CTS256A_AL2_Diagnostic
+{
+public:
+	CTS256A_AL2_Diagnostic()
+	: debugctr_( DEBUG_CTR_RELOAD )
+	{
+	}
+
+	static const bool diagnostic = true;
+
+	bool expired()
+	{
+		if ( --debugctr_ )
+			return false;
+
+		debugctr_ = DEBUG_CTR_RELOAD;
+		return true;
+	}
+
+	bool canSkip( ulong n ) const
+	{
+		return debugctr_ > n;
+	}
+
+	void skip( ulong n )
+	{
+		debugctr_ -= uint( n );
+	}
+
+	ulong skipIdle()
+	{
+		if ( debugctr_ <= 1 )
+			return 0;
+
+		ulong skipped = debugctr_ - 1;
+		debugctr_ = 1;
+		return skipped;
+	}
+
+	void reload()
+	{
+		debugctr_ = DEBUG_CTR_RELOAD;
+	}
+
+	uint getCounter() const
+	{
+		return debugctr_;
+	}
+
+	void setCounter( uint counter )
+	{
+		debugctr_ = counter;
+	}
+
+private:
+	uint	debugctr_;
+};
+
+// CTS256A-AL2 board interface: the types shared by the policies, and the
+// reads of the native routines
+class CTS256A_AL2_Board_I
+	: public Memory_I, public InOut_I
+{
+public:
+	// Hook called before the reads at addr: the opcode fetches, for the
+	// code (the operands are pre-fetched)
+	typedef void (*hook_t)( void *object, ushort addr );
+
+	// Board state, for the machine snapshots
+	struct state_t
+	{
+		uchar	ram[0x800];
+		uchar	bport;
+		uchar	initctr;
+		ushort	irq3ctr;
+		uint	debugctr;
+		uint	eofctr;
+		bool	eof;
+		uint	utterances;
+		uchar	lastInput;
+		uchar	initOutput[INIT_CTR];		///< allophones output at init
+		ushort	romAddress;					///< exception ROM location
+		uint	romSize;					///< exception ROM size
+		uint	romChecksum;				///< exception ROM checksum
+	};
+
+	// Allophone output handler, called with the allophone code (00..3F)
+	// instead of writing it to the output stream
+	typedef void (*allophoneWriter_t)( void *object, uchar allophone );
+
+	// Get the label of an allophone code
+	static const char *getAllophoneLabel( uchar allophone );
+
+	// Check if n opcode fetches can be skipped without expiring the debug
+	// or EOF counter
+	virtual bool canSkipFetches( ulong n ) = 0;
+
+	// Account the opcode fetches of n instructions run by a native routine
+	// or by compiled code, as read() would do
+	virtual void skipFetches( ulong n ) = 0;
+};
+
+template<class Policy>
+class CTS256A_AL2_Data_InOut
+	: public CTS256A_AL2_Board_I
+{
+public:
+	CTS256A_AL2_Data_InOut( TMS7000CPU &cpu, std::istream &istr,
+		std::ostream &ostr,	std::vector<uchar>&& exception_rom,
+		ushort rom_address )
+	: cpu_( cpu ), istr_( istr ), ostr_( ostr ), exception_rom_( exception_rom ),
+		rom_address_( rom_address ), bport_( 0 ), initctr_( INIT_CTR ), irq3ctr_( 0 ),
+		eof_( false ), debug_( false ),	debug_rules_( false ), verbose_( false ),
+		echo_( false ), noOK_( false ),	charInput_( false ), mode_( 'T' ),
+		ioctr_( 0 ), utterances_( 0 ), lastInput_( 0 ),
+		allophoneWriter_( 0 ), allophoneObject_( 0 ), offsets_enabled_( false ),
+		outputSize_( 0 ), flush_( FLUSH_ALLOPHONE )
+	{
+		memset( ram_, 0, 0x800 );
+		memset( hookMap_, 0, sizeof hookMap_ );
+		mapMemory();
+		resetInput();
+		romChecksum_ = getRomChecksum();
+
+		// POLL/ENDPOL loops
+		addHook( 0xF105, pollHook, this );
+		addHook( 0xF10C, pollHook, this );
+		addHook( 0xF11C, pollHook, this );
+		addHook( 0xF12F, pollHook, this );
+	}
+
+	uchar read( ushort addr );
+
+	uchar write( ushort addr, uchar data );
+
+	uchar peek( ushort addr );
+
+	// Skip the opcode fetches of an idle loop at addr up to the next event
+	ulong skipIdle( ushort addr );
+
+	// Check if n opcode fetches can be skipped without expiring the debug
+	// or EOF counter
+	bool canSkipFetches( ulong n )
+	{
+		return eof_ ? eofctr_ > n : watchdog_.canSkip( n );
+	}
+
+	// Account the opcode fetches of n instructions run by a native routine
+	// or by compiled code, as read() would do; canSkipFetches() told that no
+	// counter expires
+	void skipFetches( ulong n )
+	{
+		cpu_.TMS7000CPU::trigIRQ( 0x02 ); // trig INT1 - output interrupt
+
+		if ( !eof_ )
+			watchdog_.skip( n );
+		else if ( cpu_.getMode() != MODE_EXIT )
+			eofctr_ -= n;
+	}
+
+	// Check if hooks are registered in addr..addr+size-1
+	bool hasHooks( ushort addr, uint size )
+	{
+		uint last = addr + size - 1;
+
+		for ( uint word = addr >> 5; word <= last >> 5 && word < 0x800; ++word )
+		{
+			uint bits = hookMap_[word];
+			if ( word == uint( addr >> 5 ) )
+				bits &= ~0u << ( addr & 0x1F );
+			if ( word == last >> 5 )
+				bits &= ~0u >> ( 31 - ( last & 0x1F ) );
+			if ( bits )
+				return true;
+		}
+
+		return false;
+	}
+
+	// Check if the fetch at addr polls for input (will trigger INT3)
+	bool isInputPoll( ushort addr );
+
+	// Register a hook at addr
+	void addHook( ushort addr, hook_t hook, void *object );
+
+	// Unregister a hook at addr
+	void removeHook( ushort addr, hook_t hook, void *object );
+
+	// Get the board state
+	void getState( state_t &state );
+
+	// Set the board state, output the init allophones again;
+	// fails if the exception ROM differs
+	bool setState( const state_t &state );
+
+    reader_t getReader()
+	{
+		return readAccessor;
+	}
+
+    writer_t getWriter()
+	{
+		return writeAccessor;
+	}
+
+    void* getObject()
+	{
+		return this;
+	}
+
+	void setAllophoneWriter( allophoneWriter_t writer, void *object )
+	{
+		allophoneWriter_ = writer;
+		allophoneObject_ = object;
+	}
+
+	// Write the buffered output to the output stream, and flush it unless
+	// the policy is FLUSH_EXIT
+	void flushOutput();
+
+	// out char
+	virtual uchar out( ushort addr, uchar data );
+
+	// in char
+	virtual uchar in( ushort addr );
+
+	void setOption( uchar option, uint value );
+
+	uint getOption( uchar option );
+
+	void debug_rule();
+
+	// Exception ROM location
+	ushort getRomAddress()
+	{
+		return rom_address_;
+	}
+
+	uint getRomSize()
+	{
+		return uint( exception_rom_.size() );
+	}
+
+	const std::vector<uchar> &getExceptionRom()
+	{
+		return exception_rom_;
+	}
+
+	// Get number of input lines read
+	uint getUtterances()
+	{
+		return utterances_;
+	}
+
+	// Get number of input characters read and allophones output, for the
+	// stall checks of the release board
+	ulong getIOCount()
+	{
+		return ioctr_;
+	}
+
+	// Get the offset in the input of the next byte read
+	ulong getInputOffset()
+	{
+		return inputOffset_ + inputPos_;
+	}
+
+	// Get the input offset of the first character of the rule that output
+	// the allophone being written (option 'O'), INPUT_OFFSET_NONE if none;
+	// for the allophone writer
+	ulong getAllophoneOffset()
+	{
+		return allophoneOffset_;
+	}
+
+private:
+	typedef uchar (CTS256A_AL2_Data_InOut::*readhandler_t)( ushort addr );
+	typedef uchar (CTS256A_AL2_Data_InOut::*writehandler_t)( ushort addr, uchar data );
+
+	// Build the page table of the memory map
+	void mapMemory();
+
+	// Registered hook
+	struct hookentry_t
+	{
+		ushort	addr;
+		hook_t	hook;
+		void	*object;
+	};
+
+	// Check if hooks are registered at addr
+	bool isHooked( ushort addr )
+	{
+		return hookMap_[addr >> 5] & ( 1u << ( addr & 0x1F ) );
+	}
+
+	// Call the hooks registered at addr
+	void callHooks( ushort addr );
+
+	// Hooks of the POLL/ENDPOL loops: input and end of input
+	static void pollHook( void *object, ushort addr );
+	void pollInput( ushort addr );
+
+	// Hooks of the rules debugging mode
+	static void rulesHook( void *object, ushort addr );
+
+	// Traces (-v) and debugger stops (-d), only on the diagnostic board
+	bool isVerbose() const
+	{
+		return Policy::diagnostic && verbose_;
+	}
+
+	bool isDebug() const
+	{
+		return Policy::diagnostic && debug_;
+	}
+
+	// Check if addr is in one of the POLL/ENDPOL loops
+	static bool isPollAddress( ushort addr )
+	{
+		return addr == 0xF105 || addr == 0xF10C || addr == 0xF11C || addr == 0xF12F;
+	}
+
+	// Check if the conversion is done: input ring (R2:R3 = R4:R5) and output
+	// buffer (R7 = R9) empty
+	bool isDone()
+	{
+		return cpu_.getdata(7) == cpu_.getdata(9)
+			&& cpu_.getdata(2) == cpu_.getdata(4) && cpu_.getdata(3) == cpu_.getdata(5);
+	}
+
+	// Output an allophone
+	void putAllophone( uchar data );
+
+	// Append to the output buffer
+	void putOutput( const char *text, size_t size );
+
+	// Write the output buffer to the output stream
+	void writeOutput()
+	{
+		ostr_.write( output_, outputSize_ );
+		outputSize_ = 0;
+	}
+
+	// Store the input up to the line end directly into the input ring
+	void injectInput();
+
+	// Empty the input buffer and forget the input offsets, for a new input
+	void resetInput();
+
+	// Read the next block of the input into the input buffer; false at the
+	// end of the input
+	bool fillInput();
+
+	// Get the next input character, uppercased, without reading it;
+	// EOF at the end of the input
+	int peekInput()
+	{
+		return inputPos_ < inputEnd_ || fillInput() ? input_[inputPos_] : EOF;
+	}
+
+	// Read the next input character, uppercased; EOF at the end of the input
+	int getInput()
+	{
+		int c = peekInput();
+		if ( c != EOF )
+			++inputPos_;
+		return c;
+	}
+
+	// Get the register pair pointer Rn-1:Rn
+	ushort getPointer( uchar reg )
+	{
+		return ushort( ( cpu_.getdata( reg - 1 ) << 8 ) | cpu_.getdata( reg ) );
+	}
+
+	// Hooks of the input offsets: allophone stored into the output buffer
+	// (F4B3), allophone read from the output buffer (F393)
+	static void offsetsHook( void *object, ushort addr );
+
+	// Account an input character: echo, utterances count
+	void putInput( uchar c );
+
+	// Compute the checksum of the exception ROM
+	uint getRomChecksum();
+
+	// Page handlers, for the pages with side effects
+	uchar readInput( ushort addr );
+	uchar readExceptionRom( ushort addr );
+	uchar writeSP0256( ushort addr, uchar data );
+
+	// Memory accessors, bypassing the virtual read/write
+	static uchar readAccessor( void *object, ushort addr );
+	static uchar writeAccessor( void *object, ushort addr, uchar data );
+
+	// Memory map, by 256-byte pages: direct host pointer, or handler if null
+	const uchar				*readPages_[0x100];
+	uchar					*writePages_[0x100];
+	readhandler_t			readHandlers_[0x100];
+	writehandler_t			writeHandlers_[0x100];
+	uchar					rom_[0x1000];			///< patched ROM image
+	uchar					ones_[0x100];			///< unmapped pages (in)
+	uchar					sink_[0x100];			///< write-ignored pages
+	uint					hookMap_[0x10000 >> 5];	///< hooked addresses
+	std::vector<hookentry_t>	hooks_;
+
+	uchar					bport_;
+	TMS7000CPU				&cpu_;
+	uchar					ram_[0x800];
+	std::istream			&istr_;
+	std::ostream			&ostr_;
+	std::vector<uchar>      exception_rom_;
+	ushort                  rom_address_;
+	uint					romChecksum_;
+	uchar					initctr_;
+	uchar					initOutput_[INIT_CTR];	///< allophones output at init
+	ushort					irq3ctr_;
+	Policy					watchdog_;				///< debug watchdog
+	ulong					ioctr_;					///< inputs and outputs
+	uint					eofctr_;
+	bool					eof_;
+	bool					debug_;
+	bool					debug_rules_;
+	bool					verbose_;
+	bool					echo_;
+	bool					textMode_;
+	bool					noOK_;
+	bool					charInput_;				///< 1 INT3 per input character
+	char					mode_;
+	char					initial_;
+	uint					utterances_;
+	uchar					lastInput_;
+	allophoneWriter_t		allophoneWriter_;
+	void					*allophoneObject_;
+
+	// Input buffer
+	uchar					input_[INPUT_BUFFER_SIZE];	///< input read ahead, uppercased
+	uint					inputPos_;				///< next byte in input_
+	uint					inputEnd_;				///< end of the bytes in input_
+	ulong					inputOffset_;			///< input offset of input_[0]
+
+	// Input offsets
+	bool					offsets_enabled_;
+	ulong					offsets_[0x800];		///< input offset of the RAM bytes
+	ulong					allophoneOffset_;		///< of the allophone being written
+	ulong					lastOffset_;			///< of the last allophone output
+
+	// Output buffer
+	char					output_[OUTPUT_BUFFER_SIZE];	///< allophones not written yet
+	size_t					outputSize_;
+	char					flush_;					///< flush policy (FLUSH_*)
+};
@@ -0,0 +1,437 @@
+/*
+    CTS256A-AL2 - High-Level Emulation of the ROM Subroutines.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "CTS256A_AL2_HLE.h"
+#include "CTS256A_AL2_ROM.h"
+#include "TMS7000Ops.h"
+
+#include <array>
+#include <cstring>
+
+// Bound of the reads of a native routine call, opcode fetches included; the
+// ROM routines do far fewer
+#define HLE_MAX_READS	0x10000
+
+// Cycles of the ROM instructions, by address
+static std::array<uchar, 0x1000> makeCosts()
+{
+	std::array<uchar, 0x1000> costs;
+
+	for ( uint addr = 0; addr < 0x1000; ++addr )
+	{
+		const instr_t &instr = TMS7000CPU::instrTable[CTS256A_AL2_readRom( 0xF000 + addr )];
+		costs[addr] = instrCycles( instr.mnemon, instr.opn1, instr.opn2 );
+	}
+
+	return costs;
+}
+
+static const std::array<uchar, 0x1000> costs = makeCosts();
+
+
+CTS256A_AL2_HLE::CTS256A_AL2_HLE( TMS7000CPU &cpu, CTS256A_AL2_Board_I &data )
+: cpu_( cpu ), data_( data ), routines_( 0 ), calls_( 0 ), checks_( 0 ), mismatches_( 0 ),
+	r_( 0 ), sp_( 0 ), c_( 0 ), n_( 0 ), z_( 0 ), pc_( 0 ), instructions_( 0 ), cycles_( 0 )
+{
+}
+
+CTS256A_AL2_HLE::~CTS256A_AL2_HLE()
+{
+	setRoutines( 0 );
+}
+
+// Select the routines run natively (HLE_* mask), and the check mode
+void CTS256A_AL2_HLE::setRoutines( uint routines )
+{
+	routines_ = routines;
+	cpu_.setRoutine( 0xF488, ( routines & HLE_SCAN ) ? scanRoutine : 0, this );
+	cpu_.setRoutine( 0xF4C2, ( routines & HLE_BRACKET ) ? bracketRoutine : 0, this );
+	cpu_.setRoutine( 0xF70F, ( routines & HLE_READ ) ? readRoutine : 0, this );
+}
+
+ulong CTS256A_AL2_HLE::scanRoutine( void *object, ulong &cycles )
+{
+	return ( (CTS256A_AL2_HLE*)object )->run( &CTS256A_AL2_HLE::scan, cycles );
+}
+
+ulong CTS256A_AL2_HLE::bracketRoutine( void *object, ulong &cycles )
+{
+	return ( (CTS256A_AL2_HLE*)object )->run( &CTS256A_AL2_HLE::bracket, cycles );
+}
+
+ulong CTS256A_AL2_HLE::readRoutine( void *object, ulong &cycles )
+{
+	return ( (CTS256A_AL2_HLE*)object )->run( &CTS256A_AL2_HLE::read, cycles );
+}
+
+// Run the body of a routine from the CPU state
+ulong CTS256A_AL2_HLE::run( body_t body, ulong &cycles )
+{
+	// The code runs if its reads could expire a board counter
+	if ( !data_.canSkipFetches( HLE_MAX_READS ) )
+		return 0;
+
+	TMS7000CPU::state_t before;
+
+	if ( routines_ & HLE_CHECK )
+		cpu_.getState( before );
+
+	const st_t &st = cpu_.getFlags();
+	c_ = st.c;
+	n_ = st.n << 7;
+	z_ = !st.z;
+	r_ = cpu_.getData();
+	sp_ = cpu_.getSp();
+	instructions_ = 0;
+	cycles_ = 0;
+
+	( this->*body )();
+
+	cpu_.getSp() = sp_;
+	cpu_.setPC( pc_ );
+	cpu_.setFlags( c_, n_, z_ );
+	data_.skipFetches( instructions_ );
+	++calls_;
+
+	ulong instructions = instructions_;
+	cycles = cycles_;
+
+	if ( routines_ & HLE_CHECK )
+		check( before, instructions, cycles );
+
+	return instructions;
+}
+
+// Run the code of the routine from the state before the native call, up to
+// its RETS and with the interrupts disabled, and compare the results; the
+// board sees the reads of both
+void CTS256A_AL2_HLE::check( const TMS7000CPU::state_t &before, ulong &instructions, ulong &cycles )
+{
+	TMS7000CPU::state_t native, state = before;
+
+	cpu_.getState( native );
+
+	state.st &= ~0x10;
+	cpu_.setState( state );
+
+	uchar sp = before.sp - 2;
+
+	for ( ulong n = 0; n < HLE_MAX_READS && cpu_.getSp() != sp; ++n )
+		cpu_.sim();
+
+	cpu_.getState( state );
+	state.st |= before.st & 0x10;
+
+	++checks_;
+
+	if ( state.pc != native.pc || state.sp != native.sp || state.st != native.st
+		|| std::memcmp( state.data, native.data, sizeof state.data )
+		|| state.instructions - before.instructions != instructions
+		|| state.cycles - before.cycles != cycles )
+	{
+		++mismatches_;
+	}
+
+	// Go on with the results of the code
+	instructions = state.instructions - before.instructions;
+	cycles = state.cycles - before.cycles;
+	state.instructions = before.instructions;
+	state.cycles = before.cycles;
+	cpu_.setState( state );
+}
+
+// Account the instruction at addr
+inline void CTS256A_AL2_HLE::step( ushort addr )
+{
+	++instructions_;
+	cycles_ += costs[addr & 0xFFF];
+}
+
+// Account the conditional jump at addr; returns taken
+inline bool CTS256A_AL2_HLE::branch( ushort addr, bool taken )
+{
+	step( addr );
+	if ( taken )
+		cycles_ += 2;
+	return taken;
+}
+
+inline void CTS256A_AL2_HLE::inc( uchar n )
+{
+	uchar v = ++r_[n];
+	setcnz( v == 0, v, v );
+}
+
+inline void CTS256A_AL2_HLE::dec( uchar n )
+{
+	uchar v = --r_[n];
+	setcnz( v != 0xFF, v, v );
+}
+
+inline void CTS256A_AL2_HLE::cmp( uchar x, uchar y )
+{
+	ushort res = y - x;
+	setcnz( ( res >> 8 ) ^ 1, res, res );
+}
+
+inline void CTS256A_AL2_HLE::sub( uchar x, uchar &y )
+{
+	ushort res = y - x;
+	y = res;
+	setcnz( ( res >> 8 ) ^ 1, res, res );
+}
+
+inline void CTS256A_AL2_HLE::mov( uchar x, uchar &y )
+{
+	y = x;
+	setcnz( 0, x, x );
+}
+
+inline void CTS256A_AL2_HLE::movd( uchar src, uchar dst )
+{
+	uchar hi = r_[uchar( src - 1 )];
+	r_[dst] = r_[src];
+	r_[uchar( dst - 1 )] = hi;
+	setcnz( 0, hi, hi );
+}
+
+inline void CTS256A_AL2_HLE::decd( uchar n )
+{
+	if ( --r_[n] == 0xFF )
+	{
+		uchar hi = --r_[uchar( n - 1 )];
+		c_ = hi != 0xFF;
+	}
+	n_ = r_[uchar( n - 1 )];
+	z_ = n_;
+}
+
+inline void CTS256A_AL2_HLE::call( ushort ret )
+{
+	r_[++sp_] = ret >> 8;
+	r_[++sp_] = ret & 0xFF;
+}
+
+inline void CTS256A_AL2_HLE::rets()
+{
+	pc_ = r_[sp_--];
+	pc_ |= r_[sp_--] << 8;
+}
+
+// F488: scan the rule from R20:R21 to its B-th byte with bit 6
+void CTS256A_AL2_HLE::scan()
+{
+	step( 0xF488 ); mov( 0, r_[23] );							// CLR R23
+
+	for ( ;; )
+	{
+		step( 0xF48A ); mov( readMemory( pair( 21 ) ), r_[0] );	// LDA *R21
+
+		if ( !branch( 0xF48C, 0x40 & ~r_[0] ) )				// BTJZ %>40,A,>F496
+		{
+			step( 0xF48F ); inc( 23 );							// INC R23
+			step( 0xF491 ); cmp( r_[23], r_[1] );				// CMP R23,B
+
+			if ( !branch( 0xF493, z_ ) )						// JNZ >F496
+			{
+				step( 0xF495 ); rets();							// RETS
+				return;
+			}
+		}
+
+		step( 0xF496 ); inc( 21 );								// INC R21
+
+		if ( !branch( 0xF498, !c_ ) )							// JNC >F49C
+		{
+			step( 0xF49A ); inc( 20 );							// INC R20
+		}
+
+		step( 0xF49C );											// JMP >F48A
+	}
+}
+
+// F4C2: match the bracket of the rule at R20:R21 with the characters from
+// R2:R3 (R10 bit 5: bracket initial already matched); R10 bit 4 set if not
+// matched, else R14:R15 after the characters matched
+void CTS256A_AL2_HLE::bracket()
+{
+	bool matched;
+
+	step( 0xF4C2 ); movd( 3, 19 );								// MOVD R3,R19
+	step( 0xF4C5 ); mov( r_[10] & 0xF7, r_[10] );				// AND %>F7,R10
+
+	if ( !branch( 0xF4C8, 0x20 & ~r_[10] ) )					// BTJZ %>20,R10,>F4D4
+	{
+		step( 0xF4CC ); mov( readMemory( pair( 21 ) ), r_[0] );	// LDA *R21
+		step( 0xF4CE ); cmp( 0xFF, r_[0] );						// CMP %>FF,A
+		matched = !branch( 0xF4D0, z_ );						// JNZ >F4DD
+		if ( matched )
+			step( 0xF4D2 );										// JMP >F502
+	}
+	else
+	{
+		step( 0xF4D4 ); cmp( 0xFF, r_[0] );						// CMP %>FF,A
+		matched = branch( 0xF4D6, !z_ );						// JZ >F502
+		if ( !matched )
+		{
+			step( 0xF4D8 ); call( 0xF4DB ); previous();			// CALL @>F73B
+			step( 0xF4DB ); dec( 55 );							// DEC R55
+		}
+	}
+
+	// Compare the characters up to the last one of the bracket (bit 7)
+	while ( !matched )
+	{
+		step( 0xF4DD ); call( 0xF4E0 ); read();					// CALL @>F70F
+		step( 0xF4E0 ); cmp( 0x61, r_[0] );						// CMP %>61,A
+
+		if ( !branch( 0xF4E2, n_ & 0x80 ) )						// JN >F4E6
+		{
+			step( 0xF4E4 ); sub( 0x20, r_[0] );					// SUB %>20,A
+		}
+
+		step( 0xF4E6 ); sub( 0x20, r_[0] );						// SUB %>20,A
+		step( 0xF4E8 ); mov( r_[0], r_[1] );					// MOV A,B
+		step( 0xF4E9 ); mov( readMemory( pair( 21 ) ), r_[0] );	// LDA *R21
+
+		if ( !branch( 0xF4EB, 0x80 & ~r_[0] ) )					// BTJZ %>80,A,>F4F1
+		{
+			step( 0xF4EE ); mov( r_[10] | 0x08, r_[10] );		// OR %>08,R10
+		}
+
+		step( 0xF4F1 ); mov( r_[0] & 0x3F, r_[0] );				// AND %>3F,A
+		step( 0xF4F3 ); cmp( r_[0], r_[1] );					// CMP R0,B
+
+		if ( !branch( 0xF4F5, !z_ ) )							// JZ >F4FE
+		{
+			step( 0xF4F7 ); mov( r_[10] | 0x10, r_[10] );		// OR %>10,R10
+			step( 0xF4FA ); movd( 19, 3 );						// MOVD R19,R3
+			step( 0xF4FD ); rets();								// RETS
+			return;
+		}
+
+		matched = !branch( 0xF4FE, 0x08 & ~r_[10] );			// BTJZ %>08,R10,>F50C
+		if ( matched )
+			break;
+
+		step( 0xF50C ); inc( 21 );								// INC R21
+
+		if ( !branch( 0xF50E, !c_ ) )							// JNC >F4DD
+		{
+			step( 0xF510 ); inc( 20 );							// INC R20
+			step( 0xF512 );										// JMP >F4DD
+		}
+	}
+
+	step( 0xF502 ); movd( 3, 15 );								// MOVD R3,R15
+	step( 0xF505 ); mov( r_[10] & 0xEF, r_[10] );				// AND %>EF,R10
+	step( 0xF508 ); mov( r_[11] | 0x02, r_[11] );				// OR %>02,R11
+	step( 0xF50B ); rets();										// RETS
+}
+
+// F70F: read the character at R2:R3 from the input ring, into A without its
+// bit 7 (R10 bit 0); F298 and F311 on their read path (R10 bit 1 set, bit 2
+// clear)
+void CTS256A_AL2_HLE::read()
+{
+	step( 0xF70F ); mov( r_[10] | 0x02, r_[10] );				// OR %>02,R10
+	step( 0xF712 ); mov( r_[10] & 0xFB, r_[10] );				// AND %>FB,R10
+	step( 0xF715 ); call( 0xF718 );							// CALL @>F298
+
+	branch( 0xF298, true );										// BTJO %>02,R10,>F2CA
+	branch( 0xF2CA, false );									// BTJO %>04,R10,>F2D9
+	step( 0xF2CE ); movd( 3, 13 );								// MOVD R3,R13
+
+	if ( !branch( 0xF2D1, r_[11] & 0x02 ) )						// BTJO %>02,R11,>F2E2
+	{
+		step( 0xF2D5 ); inc( 55 );								// INC R55
+		step( 0xF2D7 );											// JMP >F2E2
+	}
+
+	step( 0xF2E2 ); mov( readMemory( pair( 13 ) ), r_[0] );		// LDA *R13
+	branch( 0xF2E4, false );									// BTJO %>04,R10,>F2F3
+
+	if ( branch( 0xF2E8, 0x80 & ~r_[0] ) )						// BTJZ %>80,A,>F2F0
+	{
+		step( 0xF2F0 ); mov( r_[10] & 0xFE, r_[10] );			// AND %>FE,R10
+	}
+	else
+	{
+		step( 0xF2EB ); mov( r_[10] | 0x01, r_[10] );			// OR %>01,R10
+		step( 0xF2EE );											// JMP >F2F3
+	}
+
+	step( 0xF2F3 ); r_[++sp_] = r_[0];							// PUSH A
+	step( 0xF2F4 ); mov( r_[0x0D], r_[0] );						// LDA @>000D
+
+	ushort res = r_[13] + 0x01;									// ADD %>01,R13
+	step( 0xF2F7 ); r_[13] = res; setcnz( ( res >> 8 ) & 1, res, r_[13] );
+	res = r_[12] + c_;											// ADC %>00,R12
+	step( 0xF2FA ); r_[12] = res; setcnz( ( res >> 8 ) & 1, res, r_[12] );
+
+	// F311: wrap around the end of the ring
+	step( 0xF2FD ); call( 0xF300 );								// CALL @>F311
+	branch( 0xF311, false );									// BTJO %>04,R10,>F323
+	step( 0xF315 ); cmp( r_[43], r_[13] );						// CMP R43,R13
+
+	if ( !branch( 0xF318, z_ ) )								// JNZ >F322
+	{
+		step( 0xF31A ); cmp( r_[42], r_[12] );					// CMP R42,R12
+
+		if ( !branch( 0xF31D, z_ ) )							// JNZ >F322
+		{
+			step( 0xF31F ); movd( 41, 13 );						// MOVD R41,R13
+		}
+	}
+
+	step( 0xF322 ); rets();										// RETS
+
+	branch( 0xF300, false );									// BTJO %>04,R10,>F309
+	step( 0xF304 ); movd( 13, 3 );								// MOVD R13,R3
+	step( 0xF307 ); r_[0] = r_[sp_--];							// POP A
+	step( 0xF308 ); rets();										// RETS
+
+	step( 0xF718 ); mov( r_[0] & 0x7F, r_[0] );					// AND %>7F,A
+	step( 0xF71A ); rets();										// RETS
+}
+
+// F73B: move R2:R3 back in the input ring
+void CTS256A_AL2_HLE::previous()
+{
+	step( 0xF73B ); decd( 3 );									// DECD R3
+	step( 0xF73D ); cmp( r_[35], r_[3] );						// CMP R35,R3
+
+	if ( !branch( 0xF740, z_ ) )								// JNZ >F74A
+	{
+		step( 0xF742 ); cmp( r_[34], r_[2] );					// CMP R34,R2
+
+		if ( !branch( 0xF745, z_ ) )							// JNZ >F74A
+		{
+			step( 0xF747 ); movd( 37, 3 );						// MOVD R37,R3
+		}
+	}
+
+	step( 0xF74A ); rets();										// RETS
+}
@@ -0,0 +1,166 @@
+/*
+    CTS256A-AL2 - High-Level Emulation of the ROM Subroutines.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "CTS256A_AL2_Data_InOut.h"
+#include "TMS7000CPU.h"
+
+// High-level emulation of the hottest subroutines of the CTS256A-AL2 ROM.
+//
+// When a block starts at the entry of one of them, its native implementation
+// runs instead of the code, and returns as its RETS does: the routines are
+// instruction by instruction transcriptions of the ROM code, updating the
+// registers, the flags, the stack bytes, SP and PC as the code does, and
+// accounting its instructions, cycles and bus reads. The interrupts raised
+// meanwhile are taken after the routine.
+//
+// The check mode runs the code after each native routine, from the same
+// state, and counts the calls ending in a different state; the interpreted
+// results are kept.
+
+// Native routines
+#define HLE_SCAN		0x01		///< F488: scan the rule to the B-th byte with bit 6
+#define HLE_BRACKET		0x02		///< F4C2: match the bracket of a rule
+#define HLE_READ		0x04		///< F70F: read a character from the input ring
+#define HLE_ALL			0x07
+#define HLE_CHECK		0x80		///< check each call against the code
+
+class CTS256A_AL2_HLE
+{
+public:
+	CTS256A_AL2_HLE( TMS7000CPU &cpu, CTS256A_AL2_Board_I &data );
+
+	~CTS256A_AL2_HLE();
+
+	// Select the routines run natively (HLE_* mask), and the check mode
+	void setRoutines( uint routines );
+
+	uint getRoutines() const
+	{
+		return routines_;
+	}
+
+	// Get the number of native calls, of the calls checked against the code
+	// and of the checked calls ending in a different state
+	ulong getCalls() const
+	{
+		return calls_;
+	}
+
+	ulong getChecks() const
+	{
+		return checks_;
+	}
+
+	ulong getMismatches() const
+	{
+		return mismatches_;
+	}
+
+private:
+	typedef void (CTS256A_AL2_HLE::*body_t)();
+
+	static ulong scanRoutine( void *object, ulong &cycles );
+
+	static ulong bracketRoutine( void *object, ulong &cycles );
+
+	static ulong readRoutine( void *object, ulong &cycles );
+
+	// Run the body of a routine from the CPU state
+	ulong run( body_t body, ulong &cycles );
+
+
+	// Run the code of the routine from the state before the native call,
+	// and compare the results
+	void check( const TMS7000CPU::state_t &before, ulong &instructions, ulong &cycles );
+
+	// Routine bodies, up to their RETS
+	void scan();			// F488
+
+	void bracket();			// F4C2
+
+	void read();			// F70F, with F298 and F311
+
+	void previous();		// F73B
+
+	// Account the instruction at addr
+	void step( ushort addr );
+
+	// Account the conditional jump at addr; returns taken
+	bool branch( ushort addr, bool taken );
+
+	// Flags, as the CPU sets them
+	void setcnz( uchar c, uchar n, ushort z )
+	{
+		c_ = c & 1;
+		n_ = n;
+		z_ = z;
+	}
+
+	// Register pair Rn-1:Rn (*Rn)
+	ushort pair( uchar n ) const
+	{
+		return ( r_[uchar( n - 1 )] << 8 ) | r_[n];
+	}
+
+	// Read the memory as the CPU does
+	uchar readMemory( ushort addr )
+	{
+		if ( addr < 0x100 )
+			return r_[addr];
+		if ( addr >= 0x200 )
+			return data_.read( addr );
+		return 0xFF;
+	}
+
+	// Instructions with their side effects on the flags
+	void inc( uchar n );
+	void dec( uchar n );
+	void cmp( uchar x, uchar y );		// CMP x,y
+	void sub( uchar x, uchar &y );		// SUB x,y
+	void mov( uchar x, uchar &y );		// MOV, AND, OR, LDA
+	void movd( uchar src, uchar dst );	// MOVD Rsrc,Rdst
+	void decd( uchar n );
+	void call( ushort ret );
+	void rets();
+
+	TMS7000CPU					&cpu_;
+	CTS256A_AL2_Board_I			&data_;
+	uint						routines_;
+	ulong						calls_;
+	ulong						checks_;
+	ulong						mismatches_;
+
+	// CPU state during a native routine
+	uchar						*r_;			///< register file
+	uchar						sp_;
+	uchar						c_;				///< C flag
+	uchar						n_;				///< N flag in bit 7
+	ushort						z_;				///< Z flag if 0
+	ushort						pc_;			///< after the RETS
+	ulong						instructions_;
+	ulong						cycles_;
+};
@@ -0,0 +1,73 @@
+/*
+    CTS256A-AL2 - CTS256A-AL2 ROM.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// CTS256A-AL2 ROM
+
+#include "runtime.h"
+
+// CTS256A_AL2 TMS7000 ROM contents (0xF000..0xFFFF)
+extern const uchar CTS256A_AL2_ROM[0x1000];
+
+// Read the ROM as seen by the emulated CPU, with the emulator patches applied
+uchar CTS256A_AL2_readRom( ushort addr );
+
+// Check if the ROM stores c as a delimiter (F248): not a letter, a digit or
+// a quote
+bool CTS256A_AL2_isDelimiter( uchar c );
+
+// Letter classes of the rule symbols, from A to Z
+#define CLASSES				0xF526
+
+// Rule tables: punctuation (F3E2), digits (F3B9), and letters from the
+// pointers at FFBE, by initial
+#define RULES_PUNCTUATION	0xF78C
+#define RULES_DIGITS		0xFF8E
+#define RULES_END			0xFFBC
+#define RULES_LETTERS		0xFFBE
+
+// Rule bytes: context symbols, brackets of the characters and allophones
+#define RULE_OPEN			0x40
+#define RULE_CLOSE			0x80
+#define RULE_EMPTY			0xFF
+
+// Context symbols
+#define SYMBOL_QUOTE		0x07	// '
+#define SYMBOL_VOWELS		0x09	// # one or more vowels
+#define SYMBOL_VOICED		0x0A	// . voiced consonant
+#define SYMBOL_SUFFIX		0x0B	// % suffix
+#define SYMBOL_SIBILANT		0x0C	// & sibilant
+#define SYMBOL_LONG_U		0x0D	// @ consonant preceding long U
+#define SYMBOL_CONSONANT	0x0E	// ^ one consonant
+#define SYMBOL_FRONT		0x0F	// + front vowel
+#define SYMBOL_CONSONANTS0	0x10	// : zero or more consonants
+#define SYMBOL_CONSONANTS1	0x11	// * one or more consonants
+#define SYMBOL_BACK			0x12	// > back vowel
+#define SYMBOL_NONLETTER	0x13	// < anything other than a letter
+#define SYMBOL_VOWELS2		0x14	// ? two or more vowels
+#define SYMBOL_LITERALS		0x15	// characters from 0x35, as code - 0x20
+#define SYMBOL_A			0x21
+#define SYMBOL_Z			0x3A
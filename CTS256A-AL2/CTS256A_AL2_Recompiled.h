@@ -0,0 +1,45 @@
+/*
+    CTS256A-AL2 - CTS256A-AL2 Recompiled ROM.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// CTS256A-AL2 ROM recompiled to C++ at build time (see recomp7000.cpp)
+
+#include "CTS256A_AL2_Data_InOut.h"
+#include "TMS7000Core.h"
+
+// Get the recompiled block starting at addr, on the release and on the
+// diagnostic board
+template<>
+const TMS7000Core<CTS256A_AL2_Data_InOut<CTS256A_AL2_Release>>::recompiled_t *
+	TMS7000Core<CTS256A_AL2_Data_InOut<CTS256A_AL2_Release>>::findRecompiled( ushort addr );
+
+template<>
+const TMS7000Core<CTS256A_AL2_Data_InOut<CTS256A_AL2_Diagnostic>>::recompiled_t *
+	TMS7000Core<CTS256A_AL2_Data_InOut<CTS256A_AL2_Diagnostic>>::findRecompiled( ushort addr );
+
+// runRecompiled() is instantiated with the recompiled blocks
+extern template ulong TMS7000Core<CTS256A_AL2_Data_InOut<CTS256A_AL2_Release>>::runRecompiled( ulong budget );
+extern template ulong TMS7000Core<CTS256A_AL2_Data_InOut<CTS256A_AL2_Diagnostic>>::runRecompiled( ulong budget );
@@ -42,11 +42,6 @@ void sigbreakhandler(int)
 
 
 
-static int regLines = 0;
-static uint pc = 0, nextpc = 0;
-static uint lastBreakPoint_ = 0xFFFF;
-static ushort hexptr = 0;
-
 static void hexDumpLine( Console_I &con, Memory_I &mem, ushort p )
 {
 	con.printf( "%04X :", p );
@@ -134,41 +129,41 @@ void ConsoleDebugger::uninit()
 
 void ConsoleDebugger::display()
 {
-	if ( !regLines )
+	if ( !regLines_ )
 	{
 		systemConsole_.println();
 		helper_.printTabSourceWidth( systemConsole_ );
 		helper_.printRegNamesLine( systemConsole_ );
 	}
 
-	regLines = ( regLines + 1 ) % 16;
+	regLines_ = ( regLines_ + 1 ) % 16;
 
-	nextpc = helper_.getPC();
+	nextpc_ = helper_.getPC();
 	systemConsole_.println();
-	helper_.printSource( systemConsole_, nextpc );
+	helper_.printSource( systemConsole_, nextpc_ );
 	helper_.printRegsLine( systemConsole_ );
 }
 
 void ConsoleDebugger::displayLast( uint lastpc )
 {
-	regLines = 0;
+	regLines_ = 0;
 	systemConsole_.println();
 	helper_.printSource( systemConsole_, lastpc );
 }
 
 void ConsoleDebugger::doCommand( int c )
 {
-	pc = helper_.getPC();
+	pc_ = helper_.getPC();
 	if ( c == 'G' ) // GO
 	{
 		breakOn_ = false;
-		regLines = 0;
+		regLines_ = 0;
 		mode_.setMode( MODE_RUN );
 		systemConsole_.putch( '\n' );
 	}
 	else if ( c == 'R' ) // SHOW REGISTER NAMES
 	{
-		regLines = 0;
+		regLines_ = 0;
 	}
 	else if ( c == 'B' ) // BREAKPOINT
 	{
@@ -177,7 +172,7 @@ void ConsoleDebugger::doCommand( int c )
 		char *str = systemConsole_.gets( buf, sizeof buf );
 		if ( !str )
 		{
-			regLines = 0;
+			regLines_ = 0;
 			return;
 		}
 		if ( !*buf )
@@ -194,9 +189,9 @@ void ConsoleDebugger::doCommand( int c )
 	}
 	else if ( c == 'C' ) // CALL STEP
 	{
-		if ( helper_.isCall( pc ) )
+		if ( helper_.isCall( pc_ ) )
 		{
-			breakPoint_ = nextpc;
+			breakPoint_ = nextpc_;
 			mode_.setMode( MODE_RUN );
 			systemConsole_.putch( '\n' );
 		}
@@ -213,47 +208,47 @@ void ConsoleDebugger::doCommand( int c )
 	}
 	else if ( c == 'E' ) // EXEC UNTIL $BREAK
 	{
-		regLines = 0;
+		regLines_ = 0;
 		mode_.setMode( MODE_RUN );
 		systemConsole_.putch( '\n' );
 	}
 	else if ( c == 'H' ) // HEX DUMP
 	{
-		regLines = 0;
+		regLines_ = 0;
 		systemConsole_.putch( '\n' );
-		hexDump( systemConsole_, helper_.getData(), hexptr );
+		hexDump( systemConsole_, helper_.getData(), hexptr_ );
 	}
 	else if ( c == ';' ) // HEX DUMP NEXT PAGE
 	{
-		hexptr += 0x0100;
-		regLines = 0;
+		hexptr_ += 0x0100;
+		regLines_ = 0;
 		systemConsole_.putch( '\n' );
-		hexDump( systemConsole_, helper_.getData(), hexptr );
+		hexDump( systemConsole_, helper_.getData(), hexptr_ );
 	}
 	else if ( c == '-' ) // HEX DUMP PREV PAGE
 	{
-		hexptr -= 0x0100;
-		regLines = 0;
+		hexptr_ -= 0x0100;
+		regLines_ = 0;
 		systemConsole_.putch( '\n' );
-		hexDump( systemConsole_, helper_.getData(), hexptr );
+		hexDump( systemConsole_, helper_.getData(), hexptr_ );
 	}
 	else if ( c == '.' ) // HEX DUMP 16 PAGES FORWARD
 	{
-		hexptr += 0x1000;
-		regLines = 0;
+		hexptr_ += 0x1000;
+		regLines_ = 0;
 		systemConsole_.putch( '\n' );
-		hexDump( systemConsole_, helper_.getData(), hexptr );
+		hexDump( systemConsole_, helper_.getData(), hexptr_ );
 	}
 	else if ( c == '_' ) // HEX DUMP 16 PAGES BACKWARD
 	{
-		hexptr -= 0x1000;
-		regLines = 0;
+		hexptr_ -= 0x1000;
+		regLines_ = 0;
 		systemConsole_.putch( '\n' );
-		hexDump( systemConsole_, helper_.getData(), hexptr );
+		hexDump( systemConsole_, helper_.getData(), hexptr_ );
 	}
 	else if ( c == 'M' ) // HEX DUMP PTRS
 	{
-		regLines = 0;
+		regLines_ = 0;
 		systemConsole_.putch( '\n' );
 		for ( int i=0; ; ++i )
 		{
@@ -273,7 +268,7 @@ void ConsoleDebugger::doCommand( int c )
 	else if ( c == 'F' ) // CHAR SET
 	{
 		showCharSet( systemConsole_ );
-		regLines = 0;
+		regLines_ = 0;
 	}
 	else if ( c == 'S' ) // SHOW SOURCE
 	{
@@ -284,12 +279,12 @@ void ConsoleDebugger::doCommand( int c )
 			systemConsole_.println();
 			helper_.printSource( systemConsole_, pctemp );
 		}
-		regLines = 0;
+		regLines_ = 0;
 	}
 	else if ( c == '?' ) // HELP
 	{
 		showHelp( systemConsole_ );
-		regLines = 0;
+		regLines_ = 0;
 	}
 
 }
@@ -34,6 +34,7 @@ public:
 	ConsoleDebugger( SystemConsole &systemConsole, DebugHelper_I &helper, Mode &mode )
 		: systemConsole_( systemConsole ), helper_( helper ), mode_( mode )
 		, breakPoint_( 0xFFFF ), breakOn_( false ), lines_( 25 )
+		, regLines_( 0 ), pc_( 0 ), nextpc_( 0 ), lastBreakPoint_( 0xFFFF ), hexptr_( 0 )
 	{
 		init();
 	}
@@ -92,5 +93,9 @@ private:
 	bool			breakOn_;
 	uint			retSP_;
 	uint			lines_;
+	int				regLines_;
+	uint			pc_, nextpc_;
+	uint			lastBreakPoint_;
+	ushort			hexptr_;
 };
 
@@ -41,6 +41,12 @@ public:
 	// read char
 	virtual uchar read( ushort addr ) = 0;
 
+	// read char without side effects (code decoding, debugging)
+	virtual uchar peek( ushort addr )
+	{
+		return read( addr );
+	}
+
     // get reader
     virtual reader_t getReader() = 0;
     
@@ -26,41 +26,10 @@
 #pragma warning(disable:4244)	// warning C4244: '%0' : conversion from '%1' to '%2', possible loss of data
 
 #include "TMS7000CPU.h"
+#include "TMS7000Ops.h"
 #include <assert.h>
 #include <cstring>
 
-//  Enumerated constants for instructions, also array subscripts
-enum {
-	ADC=0,	ADD,	AND,	ANDP,	BTJO,	BTJOP,	BTJZ,	BTJZP,
-	BR,		CALL,	CLR,	CLRC,	CMP,	CMPA,	DAC,	DEC,
-	DECD,	DINT,	DJNZ,	DSB,	EINT,	IDLE,	INC,	INV,
-	JMP,	JN,		JZ,		JC,		JP,		JPZ,	JNZ,	JNC,
-	LDA,	LDSP,	MOV,	MOVD,	MOVP,	MPY,	NOP,	OR,
-	ORP,	POP,	PUSH,	RETI,	RETS,	RL,		RLC,	RR,
-	RRC,	SBB,	SETC,	STA,	STSP,	SUB,	SWAP,	TRAP,
-	TSTA,	TSTB,	XCHB,	XOR,	XORP,	DB
-	};
-
-
-//  Enumerated constants for operands, also array subscripts
-enum {		// operand (0=none)
-	A=1, 	// A
-	B, 		// B
-	RN, 	// Rn
-	PN, 	// Pn
-	BYTE,	// %>byte
-	WORD,	// %>word
-	WORD_B, // %>word(B)
-	OFST, 	// PC+offs
-	ADDR, 	// @>addr
-	ADDR_B, // @>addr(B)
-	ATRN, 	// *Rn
-	ST, 	// ST
-	N, 		// ??
-	NTRAP, 	// TRAP n
-	OPCODE	// DB opcode
-	};
-
 
 TMS7000CPU::~TMS7000CPU()
 {
@@ -70,6 +39,15 @@ TMS7000CPU::~TMS7000CPU()
 void TMS7000CPU::init( void )
 {
 	pSt		= (st_t*)&st;
+	instructions_ = 0;
+	cycleCount_ = 0;
+	jitThreshold_ = 0;
+	fetchCheck_ = 0;
+	fetchAccount_ = 0;
+	fetchObject_ = 0;
+	idleHandler_ = 0;
+	idleObject_ = 0;
+	std::memset( routineMap_, 0, sizeof routineMap_ );
 	a		= &data[0];
 	b		= &data[1];
 	std::memset( data, 0, sizeof data );
@@ -82,7 +60,7 @@ void TMS7000CPU::reset( void )
 {
 	// 1) All 0s are written to the Status Register. This clears the global interrupt
 	//    enable bit (I), disabling all interrupts.
-	st = 0;
+	setst( 0 );
 
 	// 2) All Os are written to the IOCNTO register. This disables INT1*, INT2, and
 	//    INT3* and leaves the INTn flag bits unchanged.
@@ -92,6 +70,9 @@ void TMS7000CPU::reset( void )
 	//    TMS70Cx2 devices. This disables INT4 and INT5.
 	iocnt1_ = 0;
 
+	// Evaluate the interrupt lines after the reset
+	intevent_ = true;
+
 	// 4) The PC's MSB and LSB values before RESET* was asserted are stored in
 	//    R0 and R1 (registers A and B), respectively.
 	*a = pc_ >> 8;
@@ -108,13 +89,39 @@ void TMS7000CPU::reset( void )
 	cycles = 0;
 }
 
+// Get the CPU state, between two instructions
+void TMS7000CPU::getState( state_t &state )
+{
+	std::memcpy( state.data, data, sizeof state.data );
+	state.pc = pc_;
+	state.sp = sp;
+	state.st = getst();
+	state.iocnt0 = iocnt0_;
+	state.iocnt1 = iocnt1_;
+	state.irq = irq;
+	state.cycles = cycleCount_;
+	state.instructions = instructions_;
+}
 
-// Trigger IRQ interrupt
-void TMS7000CPU::trigIRQ( char myirq )
+// Set the CPU state
+void TMS7000CPU::setState( const state_t &state )
 {
-	irq |= myirq;
+	std::memcpy( data, state.data, sizeof data );
+	pc_ = state.pc;
+	sp = state.sp;
+	setst( state.st );
+	iocnt0_ = state.iocnt0;
+	iocnt1_ = state.iocnt1;
+	irq = state.irq;
+	cycleCount_ = state.cycles;
+	instructions_ = state.instructions;
+	cycles = 0;
+
+	// Evaluate the interrupt lines of the new state
+	intevent_ = true;
 }
 
+
 // Get IRQ status
 char TMS7000CPU::getIRQ( void )
 {
@@ -140,9 +147,11 @@ uchar TMS7000CPU::out( ushort addr, uchar byte )
 	{
 	case 0:	// IOCNT0
 		iocnt0_ = ( byte & ~0x2A ) | ( iocnt0_ & 0x2A & ~byte );
+		intevent_ = true;
 		break;
 	case 16:// IOCNT1
 		iocnt1_ = ( byte & ~0xFA ) | ( iocnt1_ & 0x0A & ~byte );
+		intevent_ = true;
 		break;
 	default:
 		if ( pExtInOut_ )
@@ -181,540 +190,415 @@ uchar TMS7000CPU::parity( const uchar x )
 	return res & 1;
 }
 
+// Execute 1 Statement
+void TMS7000CPU::sim()
+{
+	pc0_ = pc_;
+
+	// Fetch opcode
+	uchar opcode = fetch();
+
+	intblocked = 0;
+
+	// Execute opcode
+	this->simop( opcode );
+	++instructions_;
+
+	// Update the interrupt lines on events only
+	if ( intevent_ )
+		simevents();
+
+	cycleCount_ += cycles;
+	runcycles( cycles );
+	cycles = 0;
+}
+
 
-void TMS7000CPU::simtimers()
+// Declare an immutable code area to be cached as pre-decoded basic blocks
+void TMS7000CPU::addCodeCache( ushort addr, uint size )
 {
+	coderegion_t region;
+	region.addr = addr;
+	region.size = size;
+	region.blocks.resize( size );
+	codeRegions_.push_back( std::move( region ) );
 }
 
-void TMS7000CPU::simintdetect()
+// Discard the pre-decoded blocks of a code area after its contents changed
+void TMS7000CPU::invalidateCodeCache( ushort addr, uint size )
 {
-	if ( irq & 0x02 ) // IRQ1
+	for ( coderegion_t &region : codeRegions_ )
 	{
-		iocnt0_ |= 0x02; // raise IRQ1*
-		irq &= ~0x02;
+		// blocks may straddle the changed area: drop the whole region
+		if ( addr < region.addr + region.size && addr + size > region.addr )
+		{
+			for ( auto &block : region.blocks )
+				block.reset();
+		}
 	}
-	if ( irq & 0x08 ) // IRQ3
+}
+
+// Set the native routine of the subroutine at addr (0=run the code)
+void TMS7000CPU::setRoutine( ushort addr, routine_t routine, void *object )
+{
+	for ( auto it = routines_.begin(); it != routines_.end(); ++it )
 	{
-		iocnt0_ |= 0x20; // raise IRQ3*
-		irq &= ~0x08;
+		if ( it->addr == addr )
+		{
+			routines_.erase( it );
+			break;
+		}
+	}
+
+	if ( routine )
+	{
+		routines_.push_back( { addr, routine, object } );
+		routineMap_[addr >> 5] |= 1u << ( addr & 0x1F );
 	}
+	else
+		routineMap_[addr >> 5] &= ~( 1u << ( addr & 0x1F ) );
 }
 
-void TMS7000CPU::simintprocess()
+// Call the native routine at PC, with the accounting of the code it replaces
+bool TMS7000CPU::callRoutine()
 {
-	if ( pSt->i )
+	for ( const routineentry_t &entry : routines_ )
 	{
-		ushort itrap;
-		if ( ( iocnt0_ & 0x03 ) == 0x03 )
-			itrap = 1;
-		else if ( ( iocnt0_ & 0x30 ) == 0x30 )
-			itrap = 3/*, stop()*/;
-		else
-			return;
-
-		itrap = 0xFFFE - ( itrap << 1 );
-		data[++sp] = st;
-		data[++sp] = pc_ >> 8;
-		data[++sp] = pc_ & 0xFF;
-		pSt->i = 0;
-		pc_ = ( getdata( itrap ) << 8 ) | getdata( itrap+1 );
+		if ( entry.addr != pc_ )
+			continue;
+
+		ulong routineCycles = 0;
+		ulong n = entry.routine( entry.object, routineCycles );
+
+		if ( !n )
+			return false;
+
+		instructions_ += n;
+		cycleCount_ += routineCycles;
+		runcycles( routineCycles );
+
+		// The interrupts raised by the routine are taken after its RETS
+		if ( intevent_ )
+			simevents();
+
+		return true;
 	}
-	return;
 
+	return false;
 }
 
-// Execute 1 Statement
-void TMS7000CPU::sim()
+// Leave a compiled block for pc, after n instructions of blockCycles cycles;
+// takes the pending interrupts
+void TMS7000CPU::leave( ushort pc, ulong n, ulong blockCycles )
 {
-	pc0_ = pc_;
+	pc_ = pc;
+	instructions_ += n;
+	cycleCount_ += blockCycles;
+	runcycles( blockCycles );
+
+	// Update the interrupt lines on events only
+	if ( intevent_ )
+		simevents();
+}
 
-	// Fetch opcode
-	uchar opcode = fetch();
+// Leave the compiled code for pc; counts = instructions | opcode fetches not
+// accounted yet << 8
+void TMS7000CPU::jitLeave( TMS7000CPU *cpu, uint pc, uint counts, uint blockCycles )
+{
+	if ( counts >> 8 )
+		cpu->fetchAccount_( cpu->fetchObject_, counts >> 8 );
+	cpu->leave( ushort( pc ), counts & 0xFF, blockCycles );
+}
 
-	intblocked = 0;
+// Memory accesses of the compiled code, after accounting its pending opcode
+// fetches; bit 8 of the result is set to leave the code on an event or a
+// mode change
+uint TMS7000CPU::jitRead( TMS7000CPU *cpu, uint addr, uint fetches )
+{
+	if ( fetches )
+		cpu->fetchAccount_( cpu->fetchObject_, fetches );
+	uint byte = readAccessor( cpu, ushort( addr ) );
+	return byte | ( cpu->intevent_ || cpu->getMode() != MODE_RUN ? 0x100 : 0 );
+}
 
-	// Execute opcode
-	this->simop( opcode );
+uint TMS7000CPU::jitWrite( TMS7000CPU *cpu, uint addr, uint byte, uint fetches )
+{
+	if ( fetches )
+		cpu->fetchAccount_( cpu->fetchObject_, fetches );
+	writeAccessor( cpu, ushort( addr ), uchar( byte ) );
+	return cpu->intevent_ || cpu->getMode() != MODE_RUN ? 0x100 : 0;
+}
 
-	// Update timers
-	simtimers();
+// Run an instruction of the compiled code with its handler; counts =
+// instructions | opcode fetches not accounted yet << 8 | addr << 16. Leaves
+// the code if the instruction branched, raised an event or changed the mode.
+bool TMS7000CPU::jitExec( TMS7000CPU *cpu, const void *op, uint counts, uint blockCycles )
+{
+	const microop_t &microop = *(const microop_t*)op;
+	ushort addr = ushort( counts >> 16 );
+	uint fetches = ( counts >> 8 ) & 0xFF;
 
-	// Detect interrupts
-	simintdetect();
+	if ( fetches )
+		cpu->fetchAccount_( cpu->fetchObject_, fetches );
 
-	// Process interrupts
-	simintprocess();
+	cpu->pc0_ = addr;
+	cpu->pc_ = addr + 1;
+	cpu->intblocked = 0;
+	cpu->opnd_ = microop.opnd;
+	( cpu->*microop.func )( microop.opcode );
 
-	runcycles( cycles );
-	cycles = 0;
+	// The compiled code accounts the cycles of the instructions
+	ulong opCycles = cpu->cycles;
+	cpu->cycles = 0;
+
+	if ( cpu->pc_ == ushort( addr + microop.size ) && !cpu->intevent_ && cpu->getMode() == MODE_RUN )
+		return false;
+
+	cpu->leave( cpu->pc_, counts & 0xFF, blockCycles + opCycles );
+	return true;
 }
 
-void TMS7000CPU::simop( const uchar opCode )
+// Compile the cached blocks to native code after threshold runs (0=off). The
+// compiled code works on the lazy flags: with the eager ST bits, the blocks
+// stay interpreted.
+void TMS7000CPU::setJitThreshold( uint threshold )
 {
-	const instr_t &instr = this->instrTable[opCode];
-	uchar *pOpn1 = 0, *pOpn2 = 0;
-	uchar opn1 = 0, opn2 = 0, byte;
-	ushort res;
-	ushort word = 0;
+	jitThreshold_ = threshold;
 
-	switch ( instr.opn1 )
+#if TMS7000_LAZY_FLAGS
+	if ( threshold && TMS7000Jit::isSupported() )
 	{
-	case 0:			// No operand
-		break;
-	case A:			// A
-		pOpn1 = this->a;
-		break;
-	case B:			// B
-		pOpn1 = this->b;
-		break;
-	case RN:		// Rn
-		pOpn1 = this->data + this->fetch();
-		break;
-	case PN:		// Pn
-		opn1 = fetch();
-		break;
-	case BYTE:		// %>byte
-		opn1 = fetch();
-		break;
-	case WORD:		// %>word
-		word = laddr();
-		break;
-	case WORD_B:	// %>word(B)
-		word = laddr()+*b;
-		break;
-	case OFST:		// PC+offs
-		word = saddr();
-		break;
-	case ADDR:		// @>addr
-		word = laddr();
-		break;
-	case ADDR_B:	// &>addr(B)
-		word = laddr()+*b;
-		break;
-	case ATRN:		// *Rn
-		byte = fetch();
-		word = ( data[uchar(byte-1)] << 8 ) + data[byte];
-		break;
-	case ST: 		// ST
-		opn1 = this->st;
-		break;
-	case N: 		// ??
-		break;
-	case NTRAP: 	// TRAP n
-		word = 0xFFFE - ( ( 0xFF - opCode ) << 1 );
-		word = ( this->getdata( word ) << 8 ) | this->getdata( word + 1 );
-		break;
-	case OPCODE:	// DB opcode
-		stop();
-		break;
-	default:
-		stop();
+		const uchar *base = (const uchar*)this;
+		TMS7000Jit::context_t context;
+		context.data = int( data - base );
+		context.sp = int( &sp - base );
+		context.flagC = int( &flagC_ - base );
+		context.flagN = int( &flagN_ - base );
+		context.flagZ = int( (const uchar*)&flagZ_ - base );
+		context.leave = jitLeave;
+		context.read = jitRead;
+		context.write = jitWrite;
+		context.exec = jitExec;
+		jit_.reset( new TMS7000Jit( context ) );
+
+		// No code buffer: interpret the blocks
+		if ( !jit_->hasBuffer() )
+			jit_.reset();
+	}
+	else
+#endif
+	{
+		jit_.reset();
 	}
 
-	if ( pOpn1 )
-		opn1 = *pOpn1;
+	for ( coderegion_t &region : codeRegions_ )
+	{
+		for ( auto &block : region.blocks )
+		{
+			if ( block )
+			{
+				block->runs = 0;
+				block->native = 0;
+				block->nativeSize = 0;
+				block->nativeCount = 0;
+			}
+		}
+	}
+}
 
-	switch ( instr.opn2 )
+// Check if an instruction is a conditional jump
+static bool isConditionalJump( uchar opcode )
+{
+	switch ( TMS7000CPU::instrTable[opcode].mnemon )
 	{
-	case 0:			// No operand
-		break;
-	case A:			// A
-		pOpn2 = this->a;
-		break;
-	case B:			// B
-		pOpn2 = this->b;
-		break;
-	case RN:		// Rn
-		pOpn2 = this->data + this->fetch();
-		break;
-	case PN:		// Pn
-		opn2 = fetch();
-		break;
-	case BYTE:		// %>byte
-		opn2 = fetch();
-		break;
-	case WORD:		// %>word
-		word = laddr();
-		break;
-	case WORD_B:	// %>word(B)
-		word = laddr()+*b;
-		break;
-	case OFST:		// PC+offs
-		word = saddr();
-		break;
-	case ADDR:		// @>addr
-		word = laddr();
-		break;
-	case ADDR_B:	// &>addr(B)
-		word = laddr()+*b;
-		break;
-	case ATRN:		// *Rn
-		byte = fetch();
-		word = ( data[uchar(byte-1)] << 8 ) + data[byte];
-		break;
-	case ST: 		// ST
-		opn2 = this->st;
-		break;
-	case N: 		// ??
-		break;
-	case NTRAP: 	// TRAP n
-		word = 0xFFFE - ( ( 0xFF - opCode ) << 1 );
-		word = ( this->getdata( word ) << 8 ) | this->getdata( word + 1 );
-		break;
-	case OPCODE:	// DB opcode
-		stop();
-		break;
+	case BTJO:	case BTJZ:	case JN:	case JZ:	case JP:	case JPZ:
+	case JNZ:	case JNC:
+		return true;
 	default:
-		stop();
+		return false;
 	}
+}
 
-	if ( pOpn2 )
-		opn2 = *pOpn2;
+// Compile the hot block at PC to native code, extended over its conditional
+// jumps not taken; it stays interpreted if an instruction can't be compiled
+// or if the code buffer is full
+void TMS7000CPU::compileBlock( codeblock_t &block )
+{
+	// Leave the idle loops to the interpreter, for the fast-forward
+	if ( block.idle )
+		return;
 
-	// Instructions not yet implemented have a "stop();" line.
-	switch ( instr.mnemon )
+	std::vector<TMS7000Jit::op_t> ops;
+	const codeblock_t *part = &block;
+	uint size = 0;
+
+	for ( ;; )
 	{
-	case ADC:	// Add with carry
-		res = opn2 + opn1 + pSt->c;
-		opn2 = res;
-		pSt->c = ( res >> 8 ) & 1;
-		pSt->n = ( res >> 7 ) & 1;
-		pSt->z = opn2 == 0;
-		pOpn1 = 0;
-		break;
-	case ADD:	// Add
-		res = opn2 + opn1;
-		opn2 = res;
-		pSt->c = ( res >> 8 ) & 1;
-		pSt->n = ( res >> 7 ) & 1;
-		pSt->z = opn2 == 0;
-		pOpn1 = 0;
-		break;
-	case AND:	// Logical AND
-		res = opn2 & opn1;
-		opn2 = res;
-		pSt->c = 0;
-		pSt->n = ( res >> 7 ) & 1;
-		pSt->z = opn2 == 0;
-		pOpn1 = 0;
-		break;
-	case ANDP:	// AND peripheral register
-		res = indata( opn2 ) & opn1;
-		outdata( opn2, res );
-		pSt->c = 0;
-		pSt->n = ( res >> 7 ) & 1;
-		pSt->z = opn2 == 0;
-		pOpn1 = 0;
-		break;
-	case BTJO:	// Bit test and jump if one
-		word = saddr();
-		if ( opn1 & opn2 )
-			pc_ = word;
-		pOpn1 = pOpn2 = 0;
-		break;
-	case BTJOP:
-		stop();
-		break;
-	case BTJZ:	// Bit test and jump if zero
-		word = saddr();
-		if ( opn1 & ~opn2 )
-			pc_ = word;
-		pOpn1 = pOpn2 = 0;
-		break;
-	case BTJZP:
-		stop();
-		break;
-	case BR:	// Branch
-		pc_ = word;
-		break;
-	case CALL:
-		data[++sp] = pc_ >> 8;
-		data[++sp] = pc_ & 0xFF;
-		pc_ = word;
-		break;
-	case CLR:	// Clear
-		opn1 = 0;
-		pSt->c = 0;
-		pSt->n = 0;
-		pSt->z = 1;
-		break;
-	case CLRC:
-		stop();
-		break;
-	case CMP:	// Compare
-		res = opn2 - opn1;
-		pSt->c = ( res >> 8 ) ^ 1; // !! c == 0 if borrow !!
-		pSt->n = ( res >> 7 ) & 1;
-		pSt->z = res == 0;
-		pOpn1 = pOpn2 = 0;
-		break;
-	case CMPA:
-		res = read( word );
-		res = *a - res;
-		pSt->c = ( res >> 8 ) ^ 1; // !! c == 0 if borrow !!
-		pSt->n = ( res >> 7 ) & 1;
-		pSt->z = res == 0;
-		pOpn1 = pOpn2 = 0;
-		break;
-	case DAC:
-		stop();
-		break;
-	case DEC:	// Decrement
-		--opn1;
-		pSt->c = opn1 != 0xFF;
-		pSt->n = ( opn1 >> 7 ) & 1;
-		pSt->z = ( opn1 == 0 );
-		break;
-	case DECD:	// Decrement double
-		--opn1;
-		--pOpn1;
-		if ( opn1 == 0xFF )
-		{
-			--*pOpn1;
-			pSt->c = *pOpn1 != 0xFF;
-		}
-		pSt->n = ( *pOpn1 >> 7 ) & 1;
-		pSt->z = ( *pOpn1 == 0 );
-		++pOpn1;
-		break;
-	case DINT:
-		stop();
-		break;
-	case DJNZ:
-		stop();
-		break;
-	case DSB:
-		stop();
-		break;
-	case EINT:	// Enable interrupts
-		st |= 0xF0;
-		break;
-	case IDLE:
-		stop();
-		break;
-	case INC:	// Increment
-		++opn1;
-		pSt->c = pSt->z = ( opn1 == 0 );
-		pSt->n = ( opn1 >> 7 ) & 1;
-		break;
-	case INV:
-		stop();
-		break;
-	case JMP:	// Jump Unconditional
-		pc_ = word;
-		break;
-	case JN:	// Jump if negative (CNZ=x1x)
-		if ( pSt->n )
-			pc_ = word;
-		break;
-	case JZ:	// Jump if zero <=> JEQ=Jump if equal (CNZ=xx1)
-		if ( pSt->z )
-			pc_ = word;
-		break;
-	case JC:	// Jump if carry <=> JHS=Jump if higher or same (CNZ=1xx)
-		stop();
-		break;
-	case JP:	// Jump if positive (CNZ=x00)
-		if ( !pSt->n && !pSt->z )
-			pc_ = word;
-		break;
-	case JPZ:	// Jump if positive or zero (CNZ=x0x)
-		if ( !pSt->n )
-			pc_ = word;
-		break;
-	case JNZ:	// Jump if non-zero <=> JNE: Jump if not equal (CNZ=xx0)
-		if ( !pSt->z )
-			pc_ = word;
-		break;
-	case JNC:	// Jump if no carry <=> JL=Jump if lower (CNZ=0xx)
-		if ( !pSt->c )
-			pc_ = word;
-		break;
-	case LDA:	// Load register A
-		*a = res = read( word );
-		pSt->c = 0;
-		pSt->n = ( res >> 7 ) & 1;
-		pSt->z = res == 0;
-		break;
-	case LDSP:	// Load Stack Pointer
-		this->sp = *b;
-		break;
-	case MOV:	// Move
-		opn2 = opn1;
-		pSt->c = 0;
-		pSt->n = ( opn2 >> 7 ) & 1;
-		pSt->z = opn2 == 0;
-		pOpn1 = 0;
-		break;
-	case MOVD:	// Move double
-		if ( pOpn1 )
+		for ( const microop_t &op : part->ops )
 		{
-			word = ( *(pOpn1-1) << 8 ) | *pOpn1;
-			pOpn1 = 0;
+			ops.push_back( { ushort( pc_ + size ), op.opcode, op.opnd, &op } );
+			size += op.size;
 		}
 
-		if ( pOpn2 )
-		{
-			*(pOpn2-1) = res = word >> 8;
-			*pOpn2 = word & 0xFF;
-			pOpn2 = 0;
-			pSt->c = 0;
-			pSt->n = ( res >> 7 ) & 1;
-			pSt->z = res == 0;
-		}
-		else
-		{
-			stop(); // should not happen
-		}
+		// The next block follows a conditional jump, and doesn't start at a
+		// native routine or at an idle loop
+		ushort next = ushort( pc_ + size );
+		if ( !isConditionalJump( part->ops.back().opcode ) || ops.size() >= 64
+			|| ( routineMap_[next >> 5] & ( 1u << ( next & 0x1F ) ) ) )
+			break;
 
-		break;
-	case MOVP:	// Move to/from peripheral register
-		if ( instr.opn1 == PN )
-			opn1 = this->indata( opn1 );
+		part = getCodeBlock( next );
+		if ( !part || part->idle )
+			break;
+	}
 
-		pSt->c = 0;
-		pSt->n = ( opn1 >> 7 ) & 1;
-		pSt->z = opn1 == 0;
+	block.native = jit_->compile( ops );
 
-		if ( instr.opn2 == PN )
-		{
-			this->outdata( opn2, opn1 );
-			pOpn2 = 0;
-		}
-		else
+	// The code buffer was released by a failed protection change, with the
+	// code of the other blocks: back to the interpreter
+	if ( !jit_->hasBuffer() )
+	{
+		setJitThreshold( 0 );
+		return;
+	}
+
+	block.nativeSize = ushort( size );
+	block.nativeCount = ushort( ops.size() );
+}
+
+// Get the cached block starting at addr, decoding it on first use
+TMS7000CPU::codeblock_t *TMS7000CPU::getCodeBlock( ushort addr )
+{
+	for ( coderegion_t &region : codeRegions_ )
+	{
+		if ( addr >= region.addr && addr < region.addr + region.size )
 		{
-			opn2 = opn1;
+			std::unique_ptr<codeblock_t> &block = region.blocks[addr - region.addr];
+			if ( !block )
+				block.reset( decodeBlock( region, addr ) );
+			return block.get();
 		}
+	}
+	return 0;
+}
 
-		pOpn1 = 0;
-		break;
-	case MPY:	// Multiply
-		res = opn1 * opn2;
-		*a = res >> 8;
-		*b = res & 0xFF;
-		pSt->c = 0;
-		pSt->n = ( *a >> 7 ) & 1;
-		pSt->z = !*a;
-		pOpn1 = pOpn2 = 0;
-		break;
-	case NOP:
-		stop();
-		break;
-	case OR:	// Logical OR
-		res = opn2 | opn1;
-		opn2 = res;
-		pSt->c = 0;
-		pSt->n = ( res >> 7 ) & 1;
-		pSt->z = opn2 == 0;
-		pOpn1 = 0;
-		break;
-	case ORP:	// OR peripheral register
-		res = indata( opn2 ) | opn1;
-		outdata( opn2, res );
-		pSt->c = 0;
-		pSt->n = ( res >> 7 ) & 1;
-		pSt->z = opn2 == 0;
-		pOpn1 = 0;
-		break;
-	case POP:	// Pop from stack
-		opn1 = data[sp--];
-		break;
-	case PUSH:	// Push on stack
-		data[++sp] = opn1;
-		pOpn1 = 0;
-		break;
-	case RETI:	// Return from interrupt
-		pc_ = data[sp--];
-		pc_ |= data[sp--] << 8;
-		st = data[sp--];
-		break;
-	case RETS:	// Return from subroutine
-		pc_ = data[sp--];
-		pc_ |= data[sp--] << 8;
-		break;
-	case RL:
-		stop();
-		break;
-	case RLC:
-		stop();
-		break;
-	case RR:
-		stop();
-		break;
-	case RRC:	// Rotate right through carry
-		res = ( opn1 >> 1 ) | ( pSt->c << 7 );
-		pSt->c = opn1 & 1;
-		opn1 = res;
-		pSt->n = ( res >> 7 ) & 1;
-		pSt->z = res == 0;
-		break;
-	case SBB:	// Subtract with borrow
-		res = opn2 - opn1 - 1 + pSt->c;
-		opn2 = res;
-		pSt->c = ( res >> 8 ) ^ 1; // !! c == 0 if borrow !!
-		pSt->n = ( res >> 7 ) & 1;
-		pSt->z = res == 0;
-		pOpn1 = 0;
-		break;
-	case SETC:
-		stop();
-		break;
-	case STA:	// Store register A
-		write( word, res = *a );
-		pSt->c = 0;
-		pSt->n = ( res >> 7 ) & 1;
-		pSt->z = res == 0;
-		break;
-	case STSP:
-		stop();
-		break;
-	case SUB:	// Subtract
-		res = opn2 - opn1;
-		opn2 = res;
-		pSt->c = ( res >> 8 ) ^ 1; // !! c == 0 if borrow !!
-		pSt->n = ( res >> 7 ) & 1;
-		pSt->z = res == 0;
-		pOpn1 = 0;
-		break;
-	case SWAP:
-		opn1 = ( opn1 >> 4 ) | ( opn1 << 4 );
-		pSt->c = opn1 & 1;
-		pSt->n = ( opn1 >> 7 ) & 1;
-		pSt->z = !opn1;
-		break;
-	case TRAP:
-		stop();
-		break;
-	case TSTA:	// Test register A <=> CLRC=Clear carry
-		pSt->c = 0;
-		pSt->n = *a >> 7;
-		pSt->z = !*a;
-		break;
-	case TSTB:
-		stop();
-		break;
-	case XCHB:
-		stop();
-		break;
-	case XOR:
-		stop();
-		break;
-	case XORP:
-		stop();
+// Get the number of operand bytes of an addressing mode
+uint TMS7000CPU::operandSize( int opn )
+{
+	switch ( opn )
+	{
+	case RN:
+	case PN:
+	case BYTE:
+	case OFST:
+	case ATRN:
+		return 1;
+	case WORD:
+	case WORD_B:
+	case ADDR:
+	case ADDR_B:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+// Get the size in bytes of an instruction
+uint TMS7000CPU::instrSize( uchar opcode )
+{
+	const instr_t &instr = instrTable[opcode];
+	uint size = 1 + operandSize( instr.opn1 ) + operandSize( instr.opn2 );
+
+	switch ( instr.mnemon )
+	{
+	case BTJO:
+	case BTJOP:
+	case BTJZ:
+	case BTJZP:
+		++size; // jump offset
 		break;
-	case DB:
-		stop();
+	}
+
+	return size;
+}
+
+// Check if an instruction may transfer control elsewhere than the next one
+bool TMS7000CPU::isBranch( uchar opcode )
+{
+	switch ( instrTable[opcode].mnemon )
+	{
+	case BTJO:	case BTJOP:	case BTJZ:	case BTJZP:
+	case BR:	case CALL:	case JMP:	case JN:	case JZ:	case JC:
+	case JP:	case JPZ:	case JNZ:	case JNC:	case DJNZ:	case RETI:
+	case RETS:	case TRAP:	case IDLE:	case DB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Check if an instruction with its operands is a jump to itself that only
+// reads the registers and the flags: it repeats until an interrupt occurs
+bool TMS7000CPU::isIdleLoop( uchar opcode, const uchar *opnd )
+{
+	switch ( instrTable[opcode].mnemon )
+	{
+	case BTJO:	case BTJZ:	case JMP:	case JN:	case JZ:	case JC:
+	case JP:	case JPZ:	case JNZ:	case JNC:
 		break;
 	default:
-		stop();
+		return false;
 	}
 
-	if ( pOpn1 )
-		*pOpn1 = opn1;
+	int size = int( instrSize( opcode ) );
+
+	return (signed char)opnd[size - 2] == -size;
+}
+
+// Decode the basic block starting at addr
+TMS7000CPU::codeblock_t *TMS7000CPU::decodeBlock( const coderegion_t &region, ushort addr )
+{
+	std::unique_ptr<codeblock_t> block( new codeblock_t );
+	uint end = region.addr + region.size;
+	uint pc = addr;
+
+	while ( pc < end )
+	{
+		microop_t op = {};
+		op.opcode = peek( pc );
+
+		uint size = instrSize( op.opcode );
+		bool branch = isBranch( op.opcode );
+
+		// Don't decode across the end of the cached area
+		if ( pc + size > end )
+			break;
+
+		op.func = cachedOpTable[op.opcode];
+		op.size = size;
+		for ( uint i = 1; i < size; ++i )
+			op.opnd[i-1] = peek( pc + i );
 
-	if ( pOpn2 )
-		*pOpn2 = opn2;
+		block->ops.push_back( op );
+		pc += size;
 
+		if ( branch )
+			break;
+	}
+
+	if ( block->ops.empty() )
+		return 0;
+
+	const microop_t &first = block->ops.front();
+	block->idle = block->ops.size() == 1 && isIdleLoop( first.opcode, first.opnd );
+
+	return block.release();
+}
+
+// Execute 1 opcode through the opcode dispatch table
+void TMS7000CPU::simop( const uchar opCode )
+{
+	( this->*opTable[opCode] )( opCode );
 }
 
 // Stop emulation in case of invalid or non-implemented instructions.
@@ -728,7 +612,7 @@ void TMS7000CPU::stop()
 // PROCESSOR INSTRUCTIONS TABLE ///////////////////////////////////////////////
 
 //  Processor's instruction set
-instr_t TMS7000CPU::instrTable[] = {
+constexpr instr_t TMS7000CPU::instrTable[] = {
 //		mnemon,			opn1,			opn2
 // 00-0F
 		NOP,            0,              0,
@@ -1006,3 +890,16 @@ instr_t TMS7000CPU::instrTable[] = {
         0,              0,              0
 };
 
+
+// OPCODE DISPATCH TABLE //////////////////////////////////////////////////////
+
+// Build the table of opcode handlers from instrTable at compile time
+template<bool CACHED, size_t... OPCODE>
+constexpr std::array<TMS7000CPU::opfunc_t, 256> TMS7000CPU::makeOpTable( std::index_sequence<OPCODE...> )
+{
+	return { { &TMS7000CPU::exec<instrTable[OPCODE].mnemon, instrTable[OPCODE].opn1, instrTable[OPCODE].opn2, CACHED>... } };
+}
+
+const std::array<TMS7000CPU::opfunc_t, 256> TMS7000CPU::opTable = makeOpTable<false>( std::make_index_sequence<256>() );
+
+const std::array<TMS7000CPU::opfunc_t, 256> TMS7000CPU::cachedOpTable = makeOpTable<true>( std::make_index_sequence<256>() );
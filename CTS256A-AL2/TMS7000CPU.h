@@ -30,6 +30,19 @@
 #include "CPU.h"
 #include "ConsoleProxy.h"
 #include "InOut_I.h"
+#include "TMS7000Jit.h"
+
+#include <array>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Lazy flags: the ALU instructions store the values the C, N and Z flags are
+// derived from, and ST is only built when it is read as a whole (PUSH ST,
+// interrupt entry, debugger). 0 selects the eager update of the ST bits.
+#ifndef TMS7000_LAZY_FLAGS
+#define TMS7000_LAZY_FLAGS 1
+#endif
 
 class TMS7000CPU;
 
@@ -55,8 +68,15 @@ public:
 
 	// CPU abstract class
 
-	// Trigger IRQ interrupt
-	virtual void trigIRQ( char irq );
+	// Trigger IRQ interrupt; it is an event for the interrupt lines only if
+	// its flag is not raised yet in IOCNT0
+	virtual void trigIRQ( char myirq )
+	{
+		irq |= myirq;
+		if ( ( ( myirq & 0x02 ) && !( iocnt0_ & 0x02 ) ) ||
+			( ( myirq & 0x08 ) && !( iocnt0_ & 0x20 ) ) )
+			intevent_ = true;
+	}
 
 	// Get IRQ status
 	virtual char getIRQ( void );
@@ -91,22 +111,32 @@ public:
 		return 0xFF;
 	}
 
+	// peek char
+	virtual uchar peek( ushort addr )
+	{
+		if ( addr < 0x100 )
+			return this->data[addr];
+		else if ( addr >= 0x200 && this->pExtData_ )
+			return this->pExtData_->peek( addr );
+		return 0xFF;
+	}
+
     // get reader
     virtual reader_t getReader()
 	{
-		return 0;
+		return readAccessor;
 	}
     
     // get writer
     virtual writer_t getWriter()
 	{
-		return 0;
+		return writeAccessor;
 	}
     
     // get object
     virtual void* getObject()
 	{
-		return 0;
+		return this;
 	}
 
 	// InOut_I interface
@@ -135,6 +165,9 @@ public:
 	void setExtMemory( Memory_I *pExtData )
 	{
 		pExtData_ = pExtData;
+		extReader_ = pExtData->getReader();
+		extWriter_ = pExtData->getWriter();
+		extObject_ = pExtData->getObject();
 		this->setMemory( this );
 		this->setCode( this );
 	}
@@ -149,6 +182,7 @@ public:
 	// Get Flags
 	st_t& getFlags()
 	{
+		st = getst();
 		return *pSt;
 	}
 
@@ -174,32 +208,449 @@ public:
 	}
 
 
-	void simtimers();
+	void simtimers()
+	{
+	}
+
+	void simintdetect()
+	{
+		if ( irq & 0x02 ) // IRQ1
+		{
+			iocnt0_ |= 0x02; // raise IRQ1*
+			irq &= ~0x02;
+		}
+		if ( irq & 0x08 ) // IRQ3
+		{
+			iocnt0_ |= 0x20; // raise IRQ3*
+			irq &= ~0x08;
+		}
+	}
+
+	// Evaluate the interrupt lines, after an event changed them
+	void simevents()
+	{
+		intevent_ = false;
+
+		// Update timers
+		simtimers();
+
+		// Detect interrupts
+		simintdetect();
 
-	void simintdetect();
+		// Process interrupts
+		simintprocess();
+	}
 
-	void simintprocess();
+	void simintprocess()
+	{
+		if ( pSt->i )
+		{
+			ushort itrap;
+			if ( ( iocnt0_ & 0x03 ) == 0x03 )
+				itrap = 1;
+			else if ( ( iocnt0_ & 0x30 ) == 0x30 )
+				itrap = 3/*, stop()*/;
+			else
+				return;
+
+			itrap = 0xFFFE - ( itrap << 1 );
+			data[++sp] = getst();
+			data[++sp] = pc_ >> 8;
+			data[++sp] = pc_ & 0xFF;
+			pSt->i = 0;
+			pc_ = ( getdata( itrap ) << 8 ) | getdata( itrap+1 );
+		}
+	}
 
 	// Execute 1 Statement
 	void sim();
 
+	// Execute 1 basic block from the code cache (1 statement if not cached)
+	void simblock()
+	{
+		simblock( [this]( ushort addr ) { return getcode( addr ); } );
+	}
+
+	// Declare an immutable code area to be cached as pre-decoded basic blocks
+	void addCodeCache( ushort addr, uint size );
+
+	// Discard the pre-decoded blocks of a code area after its contents changed
+	void invalidateCodeCache( ushort addr, uint size );
+
+	// Compile the cached blocks to native code after threshold runs (0=off)
+	void setJitThreshold( uint threshold );
+
+	// Idle loop handler: called when a register-only instruction branched to
+	// itself, to skip the next opcode fetches at addr up to the next event.
+	// Returns the number of repetitions skipped.
+	typedef ulong (*idlehandler_t)( void *object, ushort addr );
+
+	// Set the idle loop handler (0=interpret the idle loops)
+	void setIdleHandler( idlehandler_t handler, void *object )
+	{
+		idleHandler_ = handler;
+		idleObject_ = object;
+	}
+
+	// Batched opcode fetches of the native code, which accounts them at its
+	// bus accesses and exits instead of presenting them one by one: check
+	// tells if the code of size bytes at addr can run that way for up to
+	// reads bus reads (no hook, no board counter expiring), account
+	// accounts n opcode fetches.
+	typedef bool (*fetchcheck_t)( void *object, ushort addr, uint size, ulong reads );
+	typedef void (*fetchaccount_t)( void *object, ulong n );
+
+	// Set the batched fetch handlers (0=interpret the compiled blocks)
+	void setFetchHandlers( fetchcheck_t check, fetchaccount_t account, void *object )
+	{
+		fetchCheck_ = check;
+		fetchAccount_ = account;
+		fetchObject_ = object;
+	}
+
+	// Native routine, run instead of the code of a subroutine when a block
+	// starts at its entry: it updates the registers, the flags, SP and PC as
+	// the code would up to its RETS, and adds the cycles of the code.
+	// Returns the number of instructions of the code, or 0 to run the code.
+	typedef ulong (*routine_t)( void *object, ulong &cycles );
+
+	// Set the native routine of the subroutine at addr (0=run the code)
+	void setRoutine( ushort addr, routine_t routine, void *object );
+
+	// Run the native routine at PC instead of the code, if any
+	bool simroutine()
+	{
+		return ( routineMap_[pc_ >> 5] & ( 1u << ( pc_ & 0x1F ) ) ) && callRoutine();
+	}
+
+	// Set the C, N and Z flags, for the native routines: N is bit 7 of n,
+	// Z is set if z is 0
+	void setFlags( uchar c, uchar n, ushort z )
+	{
+		setcnz( c, n, z );
+	}
+
 	void simop( const uchar opcode );
 
 	void stop();
 
+	// CPU state, for the machine snapshots
+	struct state_t
+	{
+		uchar	data[256];					///< register file
+		ushort	pc;
+		uchar	sp, st;
+		uchar	iocnt0, iocnt1;
+		uchar	irq;
+		ulong	cycles;						///< executed cycles
+		ulong	instructions;				///< executed instructions
+	};
+
+	// Get the CPU state, between two instructions
+	void getState( state_t &state );
+
+	// Set the CPU state
+	void setState( const state_t &state );
+
+	// Get number of executed instructions
+	ulong getInstructions()
+	{
+		return instructions_;
+	}
+
+	// Get number of executed cycles
+	ulong getCycles()
+	{
+		return cycleCount_;
+	}
+
+	// Execute blocks for a budget of cycles, or until leaving the RUN mode.
+	// Returns the number of cycles executed.
+	ulong runFor( ulong budget )
+	{
+		return runFor( budget, [this]( ushort addr ) { return getcode( addr ); } );
+	}
+
+	// Get the number of operand bytes of an addressing mode
+	static uint operandSize( int opn );
+
+	// Get the size in bytes of an instruction
+	static uint instrSize( uchar opcode );
+
+	// Check if an instruction may transfer control elsewhere than the next one
+	static bool isBranch( uchar opcode );
+
+	// Check if an instruction only reads registers and flags and jumps to itself
+	static bool isIdleLoop( uchar opcode, const uchar *opnd );
+
 public:
-	static instr_t	instrTable[];
+	static const instr_t	instrTable[];
+
+private:
+	typedef void (TMS7000CPU::*opfunc_t)( const uchar opCode );
+
+	// Pre-decoded instruction
+	struct microop_t
+	{
+		opfunc_t	func;					///< cached opcode handler
+		uchar		opcode;
+		uchar		size;					///< instruction size in bytes
+		uchar		opnd[3];				///< pre-fetched operand bytes
+	};
+
+	// Straight-line sequence of instructions ending with a branch
+	struct codeblock_t
+	{
+		std::vector<microop_t>	ops;
+		uint					runs = 0;		///< hotness counter
+		TMS7000Jit::code_t		native = 0;		///< compiled code
+		ushort					nativeSize = 0;	///< code bytes run by the compiled code
+		ushort					nativeCount = 0;	///< instructions run by the compiled code
+		bool					idle = false;	///< register-only self loop
+	};
+
+	// Cached code area, with the blocks indexed by start address
+	struct coderegion_t
+	{
+		ushort		addr;
+		uint		size;
+		std::vector<std::unique_ptr<codeblock_t>>	blocks;
+	};
+
+	// Fetch next operand byte, from the bus or from the pre-decoded micro-op
+	template<bool CACHED>
+	uchar opfetch()
+	{
+		if constexpr ( CACHED )
+		{
+			++pc_;
+			return *opnd_++;
+		}
+		else
+		{
+			return fetch();
+		}
+	}
+
+	// Get Long Code Address operand
+	template<bool CACHED>
+	uint opladdr()
+	{
+		uint x;
+		x = opfetch<CACHED>() << 8;
+		x += opfetch<CACHED>();
+		return x;
+	}
+
+	// Get Short Relative Code Address operand
+	template<bool CACHED>
+	uint opsaddr()
+	{
+		signed char d;
+		d = opfetch<CACHED>();
+		return pc_ + d;
+	}
+
+protected:
+	// Set the C, N and Z flags: N is bit 7 of n, Z is set if z is 0
+	void setcnz( uchar c, uchar n, ushort z )
+	{
+#if TMS7000_LAZY_FLAGS
+		flagC_ = c & 1;
+		flagN_ = n;
+		flagZ_ = z;
+#else
+		pSt->c = c;
+		pSt->n = n >> 7;
+		pSt->z = z == 0;
+#endif
+	}
+
+	// Set the C flag
+	void setc( uchar c )
+	{
+#if TMS7000_LAZY_FLAGS
+		flagC_ = c & 1;
+#else
+		pSt->c = c;
+#endif
+	}
+
+	// Set the N and Z flags
+	void setnz( uchar n, ushort z )
+	{
+#if TMS7000_LAZY_FLAGS
+		flagN_ = n;
+		flagZ_ = z;
+#else
+		pSt->n = n >> 7;
+		pSt->z = z == 0;
+#endif
+	}
+
+	// Get the C, N and Z flags
+#if TMS7000_LAZY_FLAGS
+	uchar getc() { return flagC_; }
+	bool getn() { return flagN_ & 0x80; }
+	bool getz() { return !flagZ_; }
+#else
+	uchar getc() { return pSt->c; }
+	bool getn() { return pSt->n; }
+	bool getz() { return pSt->z; }
+#endif
+
+	// Get ST, with the current C, N and Z flags
+	uchar getst()
+	{
+#if TMS7000_LAZY_FLAGS
+		return ( st & 0x1F ) | ( flagC_ << 7 ) | ( ( flagN_ & 0x80 ) >> 1 ) | ( flagZ_ ? 0 : 0x20 );
+#else
+		return st;
+#endif
+	}
+
+	// Set ST, including the C, N and Z flags
+	void setst( uchar byte )
+	{
+		st = byte;
+#if TMS7000_LAZY_FLAGS
+		flagC_ = byte >> 7;
+		flagN_ = byte << 1;
+		flagZ_ = !( byte & 0x20 );
+#endif
+	}
+
+	// Leave a compiled block for pc, after n instructions of blockCycles
+	// cycles: the compiled blocks run on the CPU state, and account their
+	// instructions and cycles at their exits, where they take the interrupts
+	void leave( ushort pc, ulong n, ulong blockCycles );
+
+private:
+	// Memory accessors, bypassing the virtual read/write
+	static uchar readAccessor( void *object, ushort addr )
+	{
+		TMS7000CPU &cpu = *(TMS7000CPU*)object;
+		if ( addr < 0x100 )
+			return cpu.data[addr];
+		else if ( addr >= 0x200 && cpu.pExtData_ )
+			return cpu.extReader_ ? cpu.extReader_( cpu.extObject_, addr ) : cpu.pExtData_->read( addr );
+		return 0xFF;
+	}
+
+	static uchar writeAccessor( void *object, ushort addr, uchar byte )
+	{
+		TMS7000CPU &cpu = *(TMS7000CPU*)object;
+		if ( addr < 0x100 )
+			cpu.data[addr] = byte;
+		else if ( addr >= 0x200 && cpu.pExtData_ )
+			cpu.extWriter_ ? cpu.extWriter_( cpu.extObject_, addr, byte ) : cpu.pExtData_->write( addr, byte );
+		return byte;
+	}
+
+	template<int OPN, bool CACHED>
+	void operand( const uchar opCode, uchar *&pOpn, uchar &opn, ushort &word );
+
+	template<int MNEMON, int OPN1, int OPN2, bool CACHED>
+	void exec( const uchar opCode );
+
+	template<bool CACHED, size_t... OPCODE>
+	static constexpr std::array<opfunc_t, 256> makeOpTable( std::index_sequence<OPCODE...> );
+
+	codeblock_t *getCodeBlock( ushort addr );
+
+	codeblock_t *decodeBlock( const coderegion_t &region, ushort addr );
+
+	void compileBlock( codeblock_t &block );
+
+	// Runtime helpers of the compiled code (see TMS7000Jit::context_t)
+	static void jitLeave( TMS7000CPU *cpu, uint pc, uint counts, uint cycles );
+	static uint jitRead( TMS7000CPU *cpu, uint addr, uint fetches );
+	static uint jitWrite( TMS7000CPU *cpu, uint addr, uint byte, uint fetches );
+	static bool jitExec( TMS7000CPU *cpu, const void *op, uint counts, uint cycles );
+
+	// Run the compiled code of a block, if its opcode fetches can be batched
+	bool runNative( const codeblock_t &block )
+	{
+		if ( !fetchCheck_ || !fetchCheck_( fetchObject_, pc_, block.nativeSize, 2 * block.nativeCount + 2 ) )
+			return false;
+
+		// The INT1 trigger of the first opcode fetch; the compiled code takes
+		// the interrupts at its exits, so it must start without event
+		TMS7000CPU::trigIRQ( 0x02 );
+		if ( intevent_ )
+			return false;
+
+		block.native( this );
+		return true;
+	}
+
+	// Call the native routine at PC
+	bool callRoutine();
+
+	// Fast-forward an idle loop, after an instruction branched to itself
+	void simidle()
+	{
+		if ( pc_ == pc0_ && idleHandler_ && getMode() == MODE_RUN )
+		{
+			ulong n = idleHandler_( idleObject_, pc_ );
+			instructions_ += n;
+			cycles += cycles * n;
+		}
+	}
+
+	static const std::array<opfunc_t, 256> opTable;
+
+	static const std::array<opfunc_t, 256> cachedOpTable;
+
+	std::vector<coderegion_t>	codeRegions_;
+	const uchar		*opnd_;
+	std::unique_ptr<TMS7000Jit>	jit_;
+	uint			jitThreshold_;
+	fetchcheck_t	fetchCheck_;
+	fetchaccount_t	fetchAccount_;
+	void			*fetchObject_;
+	idlehandler_t	idleHandler_;
+	void			*idleObject_;
+
+	// Native routine of a subroutine
+	struct routineentry_t
+	{
+		ushort		addr;
+		routine_t	routine;
+		void		*object;
+	};
+
+	uint			routineMap_[0x10000 >> 5];	///< addresses with a native routine
+	std::vector<routineentry_t>	routines_;
 
 protected:
+	template<class CodeReader>
+	void simblock( CodeReader &&codeReader );
+
+	template<class CodeReader>
+	ulong runFor( ulong budget, CodeReader &&codeReader );
+
+	uchar			data[256];
+	uchar			sp;
+	bool			intevent_;				///< Interrupt lines to be evaluated
 
 private:
 	long			cycles;
+	ulong			cycleCount_;
+	ulong			instructions_;
 	uchar			irq/*, nmi*/;
-	uchar			data[256];
 	uchar			*a, *b;
-	uchar			sp, st;
+	uchar			st;
 	st_t			*pSt;
+#if TMS7000_LAZY_FLAGS
+	uchar			flagC_;					///< C flag
+	uchar			flagN_;					///< N flag in bit 7
+	ushort			flagZ_;					///< Z flag if 0
+#endif
 	Memory_I		*pExtData_;
+	reader_t		extReader_;
+	writer_t		extWriter_;
+	void			*extObject_;
 	InOut_I			*pExtInOut_;
 	ushort			pc0_;
 
@@ -210,3 +661,69 @@ private:
 	uchar			intblocked;				///< Interrupt handling blocked( write to IE or IP )
 };
 
+// Execute 1 basic block from the code cache, presenting the opcode fetches
+// through codeReader
+template<class CodeReader>
+void TMS7000CPU::simblock( CodeReader &&codeReader )
+{
+	// Native routine instead of the code
+	if ( simroutine() )
+		return;
+
+	codeblock_t *block = getCodeBlock( pc_ );
+
+	if ( !block )
+	{
+		sim();
+		return;
+	}
+
+	if ( jit_ && !block->native && ++block->runs == jitThreshold_ )
+		compileBlock( *block );
+
+	if ( block->native && runNative( *block ) )
+		return;
+
+	for ( const microop_t &op : block->ops )
+	{
+		pc0_ = pc_;
+
+		// Present the opcode fetch on the bus; the operands are pre-fetched
+		codeReader( pc_++ );
+
+		intblocked = 0;
+
+		// Execute opcode
+		opnd_ = op.opnd;
+		( this->*op.func )( op.opcode );
+		++instructions_;
+
+		// Update the interrupt lines on events only
+		if ( intevent_ )
+			simevents();
+
+		// Skip the repetitions of an idle loop
+		if ( block->idle )
+			simidle();
+
+		cycleCount_ += cycles;
+		runcycles( cycles );
+		cycles = 0;
+
+		// Leave the block on branch, interrupt or mode change
+		if ( pc_ != pc0_ + op.size || getMode() != MODE_RUN )
+			break;
+	}
+}
+
+// Execute blocks for a budget of cycles, or until leaving the RUN mode
+template<class CodeReader>
+ulong TMS7000CPU::runFor( ulong budget, CodeReader &&codeReader )
+{
+	ulong start = cycleCount_;
+
+	while ( cycleCount_ - start < budget && getMode() == MODE_RUN )
+		simblock( codeReader );
+
+	return cycleCount_ - start;
+}
@@ -0,0 +1,209 @@
+/*
+    CTS256A-AL2 - TMS7000 CPU Emulator - Static Bus Binding.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// TMS7000 CPU bound to a board bus known at compile time
+//
+// The interpreter loop calls Bus::read directly instead of going through the
+// Memory_I interface, so that the compiler can inline the board's address
+// decoding into the loop. The virtual Memory_I/InOut_I configuration is
+// still set up for the debugger and the single-step path.
+//
+// The Bus also decides how long the idle loops can be skipped, knowing when
+// its next event (interrupt, counter expiry) occurs, and when the compiled
+// code can account its opcode fetches by blocks.
+//
+// A board may also have its ROM recompiled to member functions of its core
+// (see recomp7000.cpp), run by runRecompiled().
+
+#include "TMS7000CPU.h"
+
+template<class Bus>
+class TMS7000Core :
+	public TMS7000CPU
+{
+public:
+	TMS7000Core()
+		: bus_( 0 )
+	{
+	}
+
+	// Attach the board (external memory and I/O ports)
+	void setBus( Bus *bus )
+	{
+		bus_ = bus;
+		setExtMemory( bus );
+		setExtInOut( bus );
+		setIdleSkip( true );
+		setFetchHandlers( fetchCheckAccessor, fetchAccountAccessor, bus );
+	}
+
+	// Fast-forward the idle loops through Bus::skipIdle (else interpret them)
+	void setIdleSkip( bool skip )
+	{
+		setIdleHandler( skip ? idleAccessor : 0, bus_ );
+	}
+
+	// Execute 1 basic block from the code cache (1 statement if not cached)
+	void simblock()
+	{
+		TMS7000CPU::simblock( [this]( ushort addr ) { return readcode( addr ); } );
+	}
+
+	// Execute blocks for a budget of cycles, or until leaving the RUN mode
+	ulong runFor( ulong budget )
+	{
+		return TMS7000CPU::runFor( budget, [this]( ushort addr ) { return readcode( addr ); } );
+	}
+
+	// Execute the recompiled ROM code for a budget of cycles, or until leaving
+	// the RUN mode; the code that isn't recompiled is interpreted.
+	// Returns the number of cycles executed.
+	ulong runRecompiled( ulong budget );
+
+private:
+	// Recompiled block: straight-line code up to an unconditional branch
+	struct recompiled_t
+	{
+		void	(TMS7000Core::*code)();
+		ushort	size;					///< code size in bytes
+		ushort	count;					///< instructions
+	};
+
+	// Get the recompiled block starting at addr (0=none); defined by the
+	// recompiled code of the board
+	static const recompiled_t *findRecompiled( ushort addr );
+
+	// Recompiled block starting at ADDR
+	template<uint ADDR>
+	void recompiled();
+
+	// Check that the recompiled block at PC can account its opcode fetches
+	// at its exits: none is hooked, and no board counter expires within its
+	// bus reads (its fetches, at most one data read per instruction and the
+	// interrupt vector)
+	bool canBatchFetches( const recompiled_t &block )
+	{
+		return !bus_->Bus::hasHooks( getPC(), block.size )
+			&& bus_->Bus::canSkipFetches( 2 * block.count + 2 );
+	}
+
+	// Account the opcode fetches of n instructions, before a bus access of a
+	// recompiled block
+	void fetched( ulong n )
+	{
+		bus_->Bus::skipFetches( n );
+	}
+
+	// Leave a recompiled block for pc, after n instructions of blockCycles
+	// cycles and with fetches opcode fetches not accounted yet
+	void leave( ushort pc, ulong n, ulong blockCycles, ulong fetches )
+	{
+		if ( fetches )
+			bus_->Bus::skipFetches( fetches );
+		TMS7000CPU::leave( pc, n, blockCycles );
+	}
+
+	// Memory accesses of the recompiled code, as read() and write()
+	uchar readMemory( ushort addr )
+	{
+		if ( addr < 0x100 )
+			return data[addr];
+		else if ( addr >= 0x200 )
+			return bus_->Bus::read( addr );
+		return 0xFF;
+	}
+
+	void writeMemory( ushort addr, uchar byte )
+	{
+		if ( addr < 0x100 )
+			data[addr] = byte;
+		else if ( addr >= 0x200 )
+			bus_->Bus::write( addr, byte );
+	}
+
+	// Opcode fetch, with a non-virtual call to the board
+	uchar readcode( ushort addr )
+	{
+		if ( addr >= 0x200 )
+			return bus_->Bus::read( addr );
+		else if ( addr < 0x100 )
+			return getData()[addr];
+		return 0xFF;
+	}
+
+	static ulong idleAccessor( void *object, ushort addr )
+	{
+		return ( (Bus*)object )->Bus::skipIdle( addr );
+	}
+
+	static bool fetchCheckAccessor( void *object, ushort addr, uint size, ulong reads )
+	{
+		Bus &bus = *(Bus*)object;
+		return !bus.Bus::hasHooks( addr, size ) && bus.Bus::canSkipFetches( reads );
+	}
+
+	static void fetchAccountAccessor( void *object, ulong n )
+	{
+		( (Bus*)object )->Bus::skipFetches( n );
+	}
+
+	Bus				*bus_;
+};
+
+// Execute the recompiled ROM code for a budget of cycles, or until leaving
+// the RUN mode
+template<class Bus>
+ulong TMS7000Core<Bus>::runRecompiled( ulong budget )
+{
+	ulong start = getCycles();
+
+	while ( getCycles() - start < budget && getMode() == MODE_RUN )
+	{
+		// Native routine instead of the code
+		if ( simroutine() )
+			continue;
+
+		const recompiled_t *block = findRecompiled( getPC() );
+
+		if ( block )
+		{
+			// The INT1 trigger of the first opcode fetch; a block takes the
+			// interrupts at its exits, so it must start without event
+			TMS7000CPU::trigIRQ( 0x02 );
+
+			if ( !intevent_ && canBatchFetches( *block ) )
+			{
+				( this->*block->code )();
+				continue;
+			}
+		}
+
+		simblock();
+	}
+
+	return getCycles() - start;
+}
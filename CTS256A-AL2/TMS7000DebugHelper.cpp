@@ -27,8 +27,6 @@
 
 #include "TMS7000DebugHelper.h"
 
-#include "disas7000.h"
-
 #include <cstring>
 
 void TMS7000DebugHelper::printRegNamesLine( Console_I &console )
@@ -38,6 +36,9 @@ void TMS7000DebugHelper::printRegNamesLine( Console_I &console )
 
 void TMS7000DebugHelper::printRegsLine( Console_I &console )
 {
+	// Update ST from the lazy flags
+	cpu_.getFlags();
+
 	char intStatus = flags_.i
 		? ( cpu_.getIRQ() ? '*' : '+' )		// Interrupt enabled:  '*' = int. pending; '+' = no int. pending
 		: ( cpu_.getIRQ() ? '=' : '-' );	// Interrupt disabled: '=' = int. pending; '-' = no int. pending
@@ -68,20 +69,16 @@ void TMS7000DebugHelper::printTabSourceWidth( Console_I &console )
 	console.printf( "%*c", 36, ' ' );
 }
 
-static CPU *s_pCpu = 0;
-
-static uchar s_getData( ushort addr )
+// Read the CPU memory, for the disassembler
+uchar TMS7000DebugHelper::dataAccessor( void *object, ushort addr )
 {
-	if ( s_pCpu )
-		return s_pCpu->getdata( addr );
-	return 0xFF;
+	return ( (TMS7000CPU*)object )->getdata( addr );
 }
 
 const char *TMS7000DebugHelper::getSource( uint &_pc )
 {
-	static char src[80];
-	s_pCpu = &cpu_;
-	setTms7000MemIO( s_getData );
+	char *src = src_;
+	disass_.setReader( dataAccessor, &cpu_ );
 	disass_.setPC( _pc );
 	strcpy( src, disass_.source() );
 	_pc = disass_.getPC();
@@ -86,10 +86,14 @@ public:
 	bool isBreakRet( uint lastpc, uint retsp );
 
 private:
+	// Read the CPU memory, for the disassembler
+	static uchar dataAccessor( void *object, ushort addr );
+
 	TMS7000CPU				&cpu_;
 	TMS7000Disassembler		&disass_;
 	uchar					*data_;
 	st_t					&flags_;
 	uchar					&sp_;
+	char					src_[80];			///< last source line
 };
 
@@ -26,6 +26,7 @@
 #pragma once
 
 #include "Disassembler.h"
+#include "disas7000.h"
 
 class TMS7000Disassembler :
 	public Disassembler
@@ -33,6 +34,7 @@ class TMS7000Disassembler :
 public:
 	TMS7000Disassembler(void)
 	{
+		disas_.setMemIO( codeAccessor, this );
 	}
 
 	~TMS7000Disassembler(void)
@@ -68,5 +70,17 @@ public:
 
 	// get single instruction source
 	virtual const char *source();
+
+	// Set the memory reader of the instructions (default: the code handler)
+	void setReader( Memory_I::reader_t reader, void *object )
+	{
+		disas_.setMemIO( reader, object );
+	}
+
+private:
+	// Read the code handler without side effects
+	static uchar codeAccessor( void *object, ushort addr );
+
+	Disas7000	disas_;
 };
 
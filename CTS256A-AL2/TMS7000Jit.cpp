@@ -0,0 +1,890 @@
+/*
+    CTS256A-AL2 - TMS7000 CPU Emulator - x86-64 Dynamic Recompiler.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "TMS7000Jit.h"
+#include "TMS7000Ops.h"
+
+#include <cstring>
+
+#if defined( _M_X64 ) || defined( __x86_64__ )
+#	define JIT_X64 1
+#	if defined( _WIN32 )
+#		define WIN32_LEAN_AND_MEAN
+#		include <windows.h>
+#	else
+#		include <sys/mman.h>
+#	endif
+#endif
+
+// x86-64 registers
+enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9 };
+
+// Group 1 ALU operations (op r/m32,r32 and op r/m,imm)
+enum { ALU_ADD, ALU_OR, ALU_ADC, ALU_SBB, ALU_AND, ALU_SUB, ALU_XOR, ALU_CMP };
+
+// Group 2 shift operations
+enum { SHIFT_ROL = 0, SHIFT_SHL = 4, SHIFT_SHR = 5 };
+
+// Condition codes (jcc, setcc); CC_ALWAYS for jmp
+enum { CC_B = 2, CC_AE = 3, CC_E = 4, CC_NE = 5, CC_ALWAYS = 16 };
+
+// Argument registers of the calling convention
+#if defined( _WIN32 )
+static const uint ARG[] = { RCX, RDX, R8, R9 };
+#else
+static const uint ARG[] = { RDI, RSI, RDX, RCX };
+#endif
+
+TMS7000Jit::TMS7000Jit( const context_t &context, uint size )
+	: context_( context ), buffer_( 0 ), size_( 0 ), used_( 0 ), code_( 0 )
+	, count_( 0 ), fetched_( 0 ), cycles_( 0 )
+{
+#if JIT_X64
+#	if defined( _WIN32 )
+	void *buffer = VirtualAlloc( 0, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE );
+#	else
+	void *buffer = mmap( 0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if ( buffer == MAP_FAILED )
+		buffer = 0;
+#	endif
+	if ( buffer )
+	{
+		buffer_ = (uchar*)buffer;
+		size_ = size;
+
+		// Released if the protection fails
+		protect( true );
+	}
+#else
+	(void)size;
+#endif
+}
+
+TMS7000Jit::~TMS7000Jit()
+{
+	release();
+}
+
+// Release the code buffer
+void TMS7000Jit::release()
+{
+#if JIT_X64
+	if ( buffer_ )
+	{
+#	if defined( _WIN32 )
+		VirtualFree( buffer_, 0, MEM_RELEASE );
+#	else
+		munmap( buffer_, size_ );
+#	endif
+	}
+#endif
+	buffer_ = 0;
+	size_ = 0;
+	used_ = 0;
+}
+
+// Check if the host supports the recompiler
+bool TMS7000Jit::isSupported()
+{
+#if JIT_X64
+	return true;
+#else
+	return false;
+#endif
+}
+
+// Check if an instruction can be compiled: implemented by the interpreter,
+// with a register pair operand for MOVD and DECD
+bool TMS7000Jit::isCompilable( uchar opcode, const uchar *opnd )
+{
+	const instr_t &instr = TMS7000CPU::instrTable[opcode];
+
+	switch ( instr.mnemon )
+	{
+	case ADC:	case ADD:	case AND:	case ANDP:	case BTJO:	case BTJZ:
+	case BR:	case CALL:	case CLR:	case CMP:	case CMPA:	case DEC:
+	case EINT:	case INC:	case JMP:	case JN:	case JZ:	case JP:
+	case JPZ:	case JNZ:	case JNC:	case LDA:	case LDSP:	case MOV:
+	case MOVP:	case MPY:	case OR:	case ORP:	case POP:	case PUSH:
+	case RETI:	case RETS:	case RRC:	case SBB:	case STA:	case SUB:
+	case SWAP:	case TSTA:
+		return true;
+	case DECD:
+		return instr.opn1 == B || ( instr.opn1 == RN && opnd[0] );
+	case MOVD:
+		return instr.opn2 == RN && opnd[TMS7000CPU::operandSize( instr.opn1 )]
+			&& ( instr.opn1 != RN || opnd[0] );
+	default:
+		return false;
+	}
+}
+
+void TMS7000Jit::emit( uchar byte )
+{
+	*code_++ = byte;
+}
+
+
+void TMS7000Jit::emit32( uint word )
+{
+	memcpy( code_, &word, 4 );
+	code_ += 4;
+}
+
+void TMS7000Jit::emit64( const void *ptr )
+{
+	memcpy( code_, &ptr, 8 );
+	code_ += 8;
+}
+
+// REX prefix, if needed, of a ModRM reg field and r/m register
+void TMS7000Jit::rex( uint reg, uint rm, bool wide )
+{
+	uchar prefix = 0x40 | ( wide ? 8 : 0 ) | ( reg & 8 ? 4 : 0 ) | ( rm & 8 ? 1 : 0 );
+	if ( prefix != 0x40 )
+		emit( prefix );
+}
+
+// ModRM of [rbx+disp32]
+void TMS7000Jit::mem( uint reg, int disp )
+{
+	emit( 0x83 | ( reg & 7 ) << 3 );
+	emit32( disp );
+}
+
+// ModRM and SIB of [rbx+rcx+disp32]
+void TMS7000Jit::memIndexed( uint reg, int disp )
+{
+	emit( 0x84 | ( reg & 7 ) << 3 );
+	emit( 0x0B );
+	emit32( disp );
+}
+
+// movzx reg32,byte [rbx+disp]
+void TMS7000Jit::load( uint reg, int disp )
+{
+	rex( reg, 0, false );
+	emit( 0x0F ); emit( 0xB6 ); mem( reg, disp );
+}
+
+// movzx reg32,byte [rbx+rcx+disp]
+void TMS7000Jit::loadIndexed( uint reg, int disp )
+{
+	rex( reg, 0, false );
+	emit( 0x0F ); emit( 0xB6 ); memIndexed( reg, disp );
+}
+
+// mov byte [rbx+disp],reg8 (al, cl or dl)
+void TMS7000Jit::store( int disp, uint reg )
+{
+	emit( 0x88 ); mem( reg, disp );
+}
+
+// mov word [rbx+disp],reg16
+void TMS7000Jit::storeWord( int disp, uint reg )
+{
+	emit( 0x66 ); emit( 0x89 ); mem( reg, disp );
+}
+
+// mov byte [rbx+disp],byte
+void TMS7000Jit::storeImm( int disp, uchar byte )
+{
+	emit( 0xC6 ); mem( 0, disp ); emit( byte );
+}
+
+// mov byte [rbx+rcx+disp],byte
+void TMS7000Jit::storeIndexedImm( int disp, uchar byte )
+{
+	emit( 0xC6 ); memIndexed( 0, disp ); emit( byte );
+}
+
+// mov dst32,src32
+void TMS7000Jit::move( uint dst, uint src )
+{
+	rex( src, dst, false );
+	emit( 0x89 ); emit( 0xC0 | ( src & 7 ) << 3 | ( dst & 7 ) );
+}
+
+// mov reg32,imm32
+void TMS7000Jit::moveImm( uint reg, uint imm )
+{
+	rex( 0, reg, false );
+	emit( 0xB8 | ( reg & 7 ) ); emit32( imm );
+}
+
+// mov reg64,imm64
+void TMS7000Jit::movePtr( uint reg, const void *ptr )
+{
+	rex( 0, reg, true );
+	emit( 0xB8 | ( reg & 7 ) ); emit64( ptr );
+}
+
+// mov reg64,rbx
+void TMS7000Jit::moveCpu( uint reg )
+{
+	rex( RBX, reg, true );
+	emit( 0x89 ); emit( 0xC0 | RBX << 3 | ( reg & 7 ) );
+}
+
+// op dst32,src32 (eax, ecx or edx)
+void TMS7000Jit::alu( uint op, uint dst, uint src )
+{
+	emit( op << 3 | 1 ); emit( 0xC0 | src << 3 | dst );
+}
+
+// op reg32,imm32 (eax, ecx or edx)
+void TMS7000Jit::aluImm( uint op, uint reg, uint imm )
+{
+	emit( 0x81 ); emit( 0xC0 | op << 3 | reg ); emit32( imm );
+}
+
+// shift reg32,n (eax, ecx or edx)
+void TMS7000Jit::shift( uint op, uint reg, uchar n )
+{
+	emit( 0xC1 ); emit( 0xC0 | op << 3 | reg ); emit( n );
+}
+
+// movzx reg32,reg8 (eax, ecx or edx)
+void TMS7000Jit::zeroExtend( uint reg )
+{
+	emit( 0x0F ); emit( 0xB6 ); emit( 0xC0 | reg << 3 | reg );
+}
+
+// setcc reg8 (al, cl or dl)
+void TMS7000Jit::setcc( uint cc, uint reg )
+{
+	emit( 0x0F ); emit( 0x90 | cc ); emit( 0xC0 | reg );
+}
+
+// jcc/jmp rel32, to be resolved by patch()
+uchar *TMS7000Jit::jump( uint cc )
+{
+	if ( cc == CC_ALWAYS )
+	{
+		emit( 0xE9 );
+	}
+	else
+	{
+		emit( 0x0F ); emit( 0x80 | cc );
+	}
+	emit32( 0 );
+	return code_;
+}
+
+// Resolve a jump to the emitting pointer
+void TMS7000Jit::patch( uchar *from )
+{
+	uint rel = uint( code_ - from );
+	memcpy( from - 4, &rel, 4 );
+}
+
+// call func
+void TMS7000Jit::call( const void *func )
+{
+	movePtr( RAX, func );
+	emit( 0xFF ); emit( 0xD0 );							// call rax
+}
+
+// Restore the stack and rbx, before a ret or a tail call
+void TMS7000Jit::epilog()
+{
+#if defined( _WIN32 )
+	emit( 0x48 ); emit( 0x83 ); emit( 0xC4 ); emit( 0x20 );	// add rsp,32
+#endif
+	emit( 0x5B );										// pop rbx
+}
+
+// Offset of the register of an A, B or Rn operand
+int TMS7000Jit::regOffset( int opn, uchar byte )
+{
+	return context_.data + ( opn == A ? 0 : opn == B ? 1 : byte );
+}
+
+// Load the value of a register or immediate operand
+void TMS7000Jit::value( uint reg, int opn, uchar byte )
+{
+	if ( opn == BYTE )
+		moveImm( reg, byte );
+	else
+		load( reg, regOffset( opn, byte ) );
+}
+
+// Set N from the low byte of reg, and Z from its low word
+void TMS7000Jit::setnz( uint reg )
+{
+	store( context_.flagN, reg );
+	storeWord( context_.flagZ, reg );
+}
+
+// Set C from the low byte of reg (0 or 1)
+void TMS7000Jit::setc( uint reg )
+{
+	store( context_.flagC, reg );
+}
+
+// Set C if the subtraction in eax didn't borrow (bit 8 clear)
+void TMS7000Jit::setcNoBorrow()
+{
+	shift( SHIFT_SHR, RAX, 8 );
+	aluImm( ALU_XOR, RAX, 1 );
+	aluImm( ALU_AND, RAX, 1 );
+	setc( RAX );
+}
+
+void TMS7000Jit::clearc()
+{
+	storeImm( context_.flagC, 0 );
+}
+
+// Emit an exit to pc, or to the PC in eax if pc < 0, with extra cycles
+// (taken jump): a tail call to the leave helper
+void TMS7000Jit::leave( int pc, uint extra )
+{
+	if ( pc < 0 )
+		move( ARG[1], RAX );
+	else
+		moveImm( ARG[1], pc );
+	moveImm( ARG[2], count_ | ( count_ - fetched_ ) << 8 );
+	moveImm( ARG[3], cycles_ + extra );
+	moveCpu( ARG[0] );
+	movePtr( RAX, (const void*)context_.leave );
+	epilog();
+	emit( 0xFF ); emit( 0xE0 );							// jmp rax
+}
+
+// Compute the address of an extended addressing operand in eax
+void TMS7000Jit::address( int opn, const uchar *opnd )
+{
+	ushort word = ( opnd[0] << 8 ) | opnd[1];
+
+	switch ( opn )
+	{
+	case ADDR:
+		moveImm( RAX, word );
+		break;
+	case ADDR_B:
+		load( RAX, context_.data + 1 );
+		aluImm( ALU_ADD, RAX, word );
+		aluImm( ALU_AND, RAX, 0xFFFF );
+		break;
+	case ATRN:
+		load( RAX, context_.data + uchar( opnd[0] - 1 ) );
+		shift( SHIFT_SHL, RAX, 8 );
+		load( RCX, context_.data + opnd[0] );
+		alu( ALU_ADD, RAX, RCX );
+		break;
+	}
+}
+
+// Call the memory read or write helper, with the address in eax (and the
+// byte in ecx); the pending opcode fetches are accounted before the access
+void TMS7000Jit::callMemory( bool write )
+{
+	move( ARG[1], RAX );
+	if ( write )
+	{
+		move( ARG[2], RCX );
+		moveImm( ARG[3], count_ - fetched_ );
+	}
+	else
+	{
+		moveImm( ARG[2], count_ - fetched_ );
+	}
+	moveCpu( ARG[0] );
+	call( write ? (const void*)context_.write : (const void*)context_.read );
+	fetched_ = count_;
+}
+
+// Run an instruction through its handler, and return if it left the code
+void TMS7000Jit::exec( const op_t &op )
+{
+	movePtr( ARG[1], op.op );
+	moveImm( ARG[2], count_ | ( count_ - fetched_ ) << 8 | uint( op.addr ) << 16 );
+	moveImm( ARG[3], cycles_ );
+	moveCpu( ARG[0] );
+	call( (const void*)context_.exec );
+	fetched_ = count_;
+
+	emit( 0x84 ); emit( 0xC0 );							// test al,al
+	uchar *skip = jump( CC_E );
+	epilog();
+	emit( 0xC3 );										// ret
+	patch( skip );
+}
+
+// Compile an instruction; returns false if it ends the code
+bool TMS7000Jit::instruction( const op_t &op )
+{
+	const instr_t &instr = TMS7000CPU::instrTable[op.opcode];
+	uint size = TMS7000CPU::instrSize( op.opcode );
+	ushort next = ushort( op.addr + size );
+	ushort target = ushort( next + ( size > 1 ? (signed char)op.opnd[size - 2] : 0 ) );
+	uint cycles = instrCycles( instr.mnemon, instr.opn1, instr.opn2 );
+
+	// Operand bytes of the source and of the destination
+	const uchar *src = op.opnd;
+	const uchar *dst = op.opnd + TMS7000CPU::operandSize( instr.opn1 );
+	uchar s = src[0], d = dst[0];
+	ushort word = ( src[0] << 8 ) | src[1];
+	uchar *skip, *skip2;
+
+	// The opcode fetch is accounted with the instruction
+	++count_;
+
+	// System instructions, run by their handlers with the cycles before them
+	if ( instr.mnemon == MOVP || instr.mnemon == ANDP || instr.mnemon == ORP
+		|| instr.mnemon == EINT || instr.mnemon == RETI
+		|| ( ( instr.mnemon == PUSH || instr.mnemon == POP ) && instr.opn1 == ST ) )
+	{
+		exec( op );
+		cycles_ += cycles;
+		return true;
+	}
+
+	cycles_ += cycles;
+
+	switch ( instr.mnemon )
+	{
+	case ADC:
+	case ADD:
+		load( RAX, regOffset( instr.opn2, d ) );
+		value( RCX, instr.opn1, s );
+		alu( ALU_ADD, RAX, RCX );
+		if ( instr.mnemon == ADC )
+		{
+			load( RCX, context_.flagC );
+			alu( ALU_ADD, RAX, RCX );
+		}
+		store( regOffset( instr.opn2, d ), RAX );
+		move( RCX, RAX );
+		shift( SHIFT_SHR, RCX, 8 );
+		setc( RCX );
+		zeroExtend( RAX );
+		setnz( RAX );
+		break;
+	case SUB:
+	case SBB:
+	case CMP:
+		load( RAX, regOffset( instr.opn2, d ) );
+		value( RCX, instr.opn1, s );
+		alu( ALU_SUB, RAX, RCX );
+		if ( instr.mnemon == SBB )
+		{
+			load( RCX, context_.flagC );
+			alu( ALU_ADD, RAX, RCX );
+			aluImm( ALU_SUB, RAX, 1 );
+		}
+		if ( instr.mnemon != CMP )
+			store( regOffset( instr.opn2, d ), RAX );
+		setnz( RAX );
+		setcNoBorrow();
+		break;
+	case AND:
+	case OR:
+		load( RAX, regOffset( instr.opn2, d ) );
+		value( RCX, instr.opn1, s );
+		alu( instr.mnemon == AND ? ALU_AND : ALU_OR, RAX, RCX );
+		store( regOffset( instr.opn2, d ), RAX );
+		setnz( RAX );
+		clearc();
+		break;
+	case MOV:
+		value( RAX, instr.opn1, s );
+		store( regOffset( instr.opn2, d ), RAX );
+		setnz( RAX );
+		clearc();
+		break;
+	case MPY:
+		value( RAX, instr.opn1, s );
+		value( RCX, instr.opn2, d );
+		emit( 0x0F ); emit( 0xAF ); emit( 0xC1 );		// imul eax,ecx
+		store( context_.data + 1, RAX );
+		shift( SHIFT_SHR, RAX, 8 );
+		store( context_.data, RAX );
+		setnz( RAX );
+		clearc();
+		break;
+	case BTJO:
+	case BTJZ:
+		value( RAX, instr.opn1, s );
+		value( RCX, instr.opn2, d );
+		if ( instr.mnemon == BTJZ )
+		{
+			emit( 0xF7 ); emit( 0xD1 );					// not ecx
+		}
+		emit( 0x85 ); emit( 0xC8 );						// test eax,ecx
+		skip = jump( CC_E );
+		leave( target, 2 );
+		patch( skip );
+		break;
+	case INC:
+	case DEC:
+		load( RAX, regOffset( instr.opn1, s ) );
+		aluImm( instr.mnemon == INC ? ALU_ADD : ALU_SUB, RAX, 1 );
+		store( regOffset( instr.opn1, s ), RAX );
+		zeroExtend( RAX );
+		setnz( RAX );
+		if ( instr.mnemon == INC )
+		{
+			emit( 0x85 ); emit( 0xC0 );					// test eax,eax
+			setcc( CC_E, RCX );
+		}
+		else
+		{
+			aluImm( ALU_CMP, RAX, 0xFF );
+			setcc( CC_NE, RCX );
+		}
+		setc( RCX );
+		break;
+	case CLR:
+		alu( ALU_XOR, RAX, RAX );
+		store( regOffset( instr.opn1, s ), RAX );
+		setnz( RAX );
+		setc( RAX );
+		break;
+	case SWAP:
+		load( RAX, regOffset( instr.opn1, s ) );
+		emit( 0xC0 ); emit( 0xC0 ); emit( 4 );			// rol al,4
+		store( regOffset( instr.opn1, s ), RAX );
+		zeroExtend( RAX );
+		setnz( RAX );
+		aluImm( ALU_AND, RAX, 1 );
+		setc( RAX );
+		break;
+	case RRC:
+		load( RAX, regOffset( instr.opn1, s ) );
+		load( RCX, context_.flagC );
+		move( RDX, RAX );
+		aluImm( ALU_AND, RDX, 1 );
+		shift( SHIFT_SHR, RAX, 1 );
+		shift( SHIFT_SHL, RCX, 7 );
+		alu( ALU_OR, RAX, RCX );
+		store( regOffset( instr.opn1, s ), RAX );
+		setnz( RAX );
+		setc( RDX );
+		break;
+	case DECD:
+	{
+		// The MSB is decremented on a borrow from the LSB, which also
+		// updates C
+		int lo = regOffset( instr.opn1, s );
+		emit( 0x80 ); mem( ALU_SUB, lo ); emit( 1 );	// sub byte [lo],1
+		skip = jump( CC_AE );
+		emit( 0x80 ); mem( ALU_SUB, lo - 1 ); emit( 1 );	// sub byte [hi],1
+		setcc( CC_AE, RCX );
+		setc( RCX );
+		patch( skip );
+		load( RAX, lo - 1 );
+		setnz( RAX );
+		break;
+	}
+	case TSTA:
+		load( RAX, context_.data );
+		setnz( RAX );
+		clearc();
+		break;
+	case LDSP:
+		load( RAX, context_.data + 1 );
+		store( context_.sp, RAX );
+		break;
+	case PUSH:
+		load( RCX, context_.sp );
+		emit( 0xFE ); emit( 0xC1 );						// inc cl
+		store( context_.sp, RCX );
+		load( RAX, regOffset( instr.opn1, s ) );
+		emit( 0x88 ); memIndexed( RAX, context_.data );	// mov [rbx+rcx+data],al
+		break;
+	case POP:
+		load( RCX, context_.sp );
+		loadIndexed( RAX, context_.data );
+		emit( 0xFE ); emit( 0xC9 );						// dec cl
+		store( context_.sp, RCX );
+		store( regOffset( instr.opn1, s ), RAX );
+		break;
+	case MOVD:
+	{
+		int lo = context_.data + d;
+		if ( instr.opn1 == WORD )
+		{
+			storeImm( lo - 1, src[0] );
+			storeImm( lo, src[1] );
+			moveImm( RAX, src[0] );
+			setnz( RAX );
+			clearc();
+			break;
+		}
+		if ( instr.opn1 == RN )
+		{
+			load( RAX, context_.data + s - 1 );
+			load( RCX, context_.data + s );
+		}
+		else
+		{
+			load( RAX, context_.data + 1 );
+			aluImm( ALU_ADD, RAX, word );
+			move( RCX, RAX );
+			shift( SHIFT_SHR, RAX, 8 );
+			aluImm( ALU_AND, RAX, 0xFF );
+		}
+		store( lo - 1, RAX );
+		store( lo, RCX );
+		setnz( RAX );
+		clearc();
+		break;
+	}
+	case LDA:
+	case STA:
+	case CMPA:
+		if ( instr.opn1 == ADDR && word < 0x100 )
+		{
+			// Register file
+			if ( instr.mnemon == STA )
+			{
+				load( RAX, context_.data );
+				store( context_.data + word, RAX );
+			}
+			else
+			{
+				load( RAX, context_.data + word );
+				if ( instr.mnemon == LDA )
+					store( context_.data, RAX );
+			}
+			if ( instr.mnemon == CMPA )
+			{
+				move( RCX, RAX );
+				load( RAX, context_.data );
+				alu( ALU_SUB, RAX, RCX );
+				setnz( RAX );
+				setcNoBorrow();
+			}
+			else
+			{
+				setnz( RAX );
+				clearc();
+			}
+			break;
+		}
+
+		// External memory: the helper result is kept in edx, to leave after
+		// the instruction on an event or a mode change
+		address( instr.opn1, src );
+		if ( instr.mnemon == STA )
+			load( RCX, context_.data );
+		callMemory( instr.mnemon == STA );
+		move( RDX, RAX );
+		if ( instr.mnemon == STA )
+		{
+			load( RAX, context_.data );
+			setnz( RAX );
+			clearc();
+		}
+		else
+		{
+			zeroExtend( RAX );
+			if ( instr.mnemon == LDA )
+			{
+				store( context_.data, RAX );
+				setnz( RAX );
+				clearc();
+			}
+			else
+			{
+				move( RCX, RAX );
+				load( RAX, context_.data );
+				alu( ALU_SUB, RAX, RCX );
+				setnz( RAX );
+				setcNoBorrow();
+			}
+			shift( SHIFT_SHR, RDX, 8 );
+		}
+		emit( 0x85 ); emit( 0xD2 );						// test edx,edx
+		skip = jump( CC_E );
+		leave( next );
+		patch( skip );
+		break;
+	case JN:
+	case JPZ:
+		emit( 0xF6 ); mem( 0, context_.flagN ); emit( 0x80 );	// test byte [N],0x80
+		skip = jump( instr.mnemon == JN ? CC_E : CC_NE );
+		leave( target, 2 );
+		patch( skip );
+		break;
+	case JZ:
+	case JNZ:
+		emit( 0x66 ); emit( 0x83 ); mem( ALU_CMP, context_.flagZ ); emit( 0 );	// cmp word [Z],0
+		skip = jump( instr.mnemon == JZ ? CC_NE : CC_E );
+		leave( target, 2 );
+		patch( skip );
+		break;
+	case JP:
+		emit( 0xF6 ); mem( 0, context_.flagN ); emit( 0x80 );	// test byte [N],0x80
+		skip = jump( CC_NE );
+		emit( 0x66 ); emit( 0x83 ); mem( ALU_CMP, context_.flagZ ); emit( 0 );	// cmp word [Z],0
+		skip2 = jump( CC_E );
+		leave( target, 2 );
+		patch( skip );
+		patch( skip2 );
+		break;
+	case JNC:
+		emit( 0x80 ); mem( ALU_CMP, context_.flagC ); emit( 0 );	// cmp byte [C],0
+		skip = jump( CC_NE );
+		leave( target, 2 );
+		patch( skip );
+		break;
+	case JMP:
+		leave( target );
+		return false;
+	case BR:
+		if ( instr.opn1 == ADDR )
+		{
+			leave( word );
+		}
+		else
+		{
+			address( instr.opn1, src );
+			leave( -1 );
+		}
+		return false;
+	case CALL:
+		if ( instr.opn1 != ADDR )
+			address( instr.opn1, src );
+		load( RCX, context_.sp );
+		emit( 0xFE ); emit( 0xC1 );						// inc cl
+		storeIndexedImm( context_.data, uchar( next >> 8 ) );
+		emit( 0xFE ); emit( 0xC1 );						// inc cl
+		storeIndexedImm( context_.data, uchar( next ) );
+		store( context_.sp, RCX );
+		leave( instr.opn1 == ADDR ? word : -1 );
+		return false;
+	case RETS:
+		load( RCX, context_.sp );
+		loadIndexed( RAX, context_.data );
+		emit( 0xFE ); emit( 0xC9 );						// dec cl
+		loadIndexed( RDX, context_.data );
+		emit( 0xFE ); emit( 0xC9 );						// dec cl
+		store( context_.sp, RCX );
+		shift( SHIFT_SHL, RDX, 8 );
+		alu( ALU_OR, RAX, RDX );
+		leave( -1 );
+		return false;
+	}
+
+	return true;
+}
+
+// Make the code buffer writable or executable. On failure, releases the
+// buffer and returns false, as if it could not be allocated.
+bool TMS7000Jit::protect( bool exec )
+{
+#if JIT_X64
+#	if defined( _WIN32 )
+	DWORD old;
+	bool ok = VirtualProtect( buffer_, size_, exec ? PAGE_EXECUTE_READ : PAGE_READWRITE, &old ) != 0;
+	if ( ok && exec )
+		FlushInstructionCache( GetCurrentProcess(), buffer_, size_ );
+#	else
+	bool ok = mprotect( buffer_, size_, exec ? PROT_READ | PROT_EXEC : PROT_READ | PROT_WRITE ) == 0;
+#	endif
+	if ( !ok )
+		release();
+	return ok;
+#else
+	(void)exec;
+	return false;
+#endif
+}
+
+// Compile a superblock. Returns 0 if an instruction can't be compiled or if
+// the code buffer is full.
+//
+// Generated code (System V ABI; Win64 uses rcx, rdx, r8, r9 and a shadow space):
+//		push	rbx
+//		mov		rbx,rdi				; cpu
+//	; for each instruction: its operation on the registers and flags, with
+//	; the exits of the conditional jumps taken and of the callouts
+//		...
+//	; exit (jumps, end of the code): tail call of the leave helper
+//		mov		esi,pc
+//		mov		edx,counts
+//		mov		ecx,cycles
+//		mov		rdi,rbx
+//		mov		rax,leave
+//		pop		rbx
+//		jmp		rax
+TMS7000Jit::code_t TMS7000Jit::compile( const std::vector<op_t> &ops )
+{
+#if JIT_X64
+	// Upper bound of the code of an instruction with its exits
+	const uint prologSize = 16, opSize = 256;
+
+	// 16-byte aligned entry points
+	uint start = ( used_ + 15 ) & ~15u;
+
+	if ( !buffer_ || ops.empty() || ops.size() > 0xFF
+		|| start + prologSize + opSize * uint( ops.size() ) > size_ )
+		return 0;
+
+	for ( const op_t &op : ops )
+	{
+		if ( !isCompilable( op.opcode, op.opnd ) )
+			return 0;
+	}
+
+	if ( !protect( false ) )
+		return 0;
+
+	code_ = buffer_ + start;
+	count_ = fetched_ = cycles_ = 0;
+
+	emit( 0x53 );										// push rbx
+#	if defined( _WIN32 )
+	emit( 0x48 ); emit( 0x83 ); emit( 0xEC ); emit( 0x20 );	// sub rsp,32
+#	endif
+	rex( ARG[0], RBX, true );
+	emit( 0x89 ); emit( 0xC0 | ( ARG[0] & 7 ) << 3 | RBX );	// mov rbx,cpu
+
+	bool open = true;
+	for ( const op_t &op : ops )
+	{
+		open = instruction( op );
+		if ( !open )
+			break;
+	}
+
+	// End of the code: the last conditional jump not taken
+	if ( open )
+		leave( ushort( ops.back().addr + TMS7000CPU::instrSize( ops.back().opcode ) ) );
+
+	used_ = uint( code_ - buffer_ );
+
+	if ( !protect( true ) )
+		return 0;
+
+	return (code_t)( buffer_ + start );
+#else
+	(void)ops;
+	return 0;
+#endif
+}
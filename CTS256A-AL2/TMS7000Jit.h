@@ -0,0 +1,171 @@
+/*
+    CTS256A-AL2 - TMS7000 CPU Emulator - x86-64 Dynamic Recompiler.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// TMS7000 x86-64 dynamic recompiler
+//
+// Translates a superblock (a basic block extended over its conditional jumps
+// not taken) into x86-64 code working on the CPU state: the register file,
+// SP and the lazy C, N and Z flags are accessed at their offsets from rbx.
+// The external memory accesses and the rare system instructions call out to
+// the CPU; the code accounts its instructions and cycles at its exits. The
+// generated code lives in an executable buffer allocated by the OS (mmap /
+// VirtualAlloc), writable only while compiling.
+
+#include "runtime.h"
+
+#include <vector>
+
+class TMS7000CPU;
+
+class TMS7000Jit
+{
+public:
+	// Compiled block
+	typedef void (*code_t)( TMS7000CPU *cpu );
+
+	// Layout of the CPU state and runtime helpers of the compiled code
+	struct context_t
+	{
+		int		data;					///< offset of the register file
+		int		sp;						///< offset of SP
+		int		flagC;					///< offset of the C flag (0 or 1)
+		int		flagN;					///< offset of the N flag (bit 7)
+		int		flagZ;					///< offset of the Z flag (ushort, set if 0)
+
+		// Leave the code for pc; counts = instructions | opcode fetches not
+		// accounted yet << 8
+		void	(*leave)( TMS7000CPU *cpu, uint pc, uint counts, uint cycles );
+
+		// Read or write the memory, after accounting fetches opcode fetches;
+		// bit 8 of the result is set if the code must leave (event or mode
+		// change)
+		uint	(*read)( TMS7000CPU *cpu, uint addr, uint fetches );
+		uint	(*write)( TMS7000CPU *cpu, uint addr, uint byte, uint fetches );
+
+		// Run the pre-decoded instruction op with its handler; counts =
+		// instructions | opcode fetches not accounted yet << 8 | addr << 16,
+		// cycles = the cycles before the instruction. Returns true if it left
+		// the code.
+		bool	(*exec)( TMS7000CPU *cpu, const void *op, uint counts, uint cycles );
+	};
+
+	// Instruction to compile
+	struct op_t
+	{
+		ushort			addr;
+		uchar			opcode;
+		const uchar		*opnd;					///< operand bytes
+		const void		*op;					///< pre-decoded instruction, for exec
+	};
+
+	TMS7000Jit( const context_t &context, uint size = 0x100000 );
+
+	~TMS7000Jit();
+
+	// Check if the host supports the recompiler
+	static bool isSupported();
+
+	// Check if an instruction can be compiled
+	static bool isCompilable( uchar opcode, const uchar *opnd );
+
+	// Check if the code buffer is available. It is released if its
+	// allocation or a protection change failed: the code compiled so far is
+	// lost, and nothing more can be compiled.
+	bool hasBuffer() const
+	{
+		return buffer_ != 0;
+	}
+
+	// Compile a superblock. Returns 0 if an instruction can't be compiled,
+	// if the code buffer is full or if it was released.
+	code_t compile( const std::vector<op_t> &ops );
+
+private:
+	void emit( uchar byte );
+
+
+	void emit32( uint word );
+
+	void emit64( const void *ptr );
+
+	// Instruction encoding
+	void rex( uint reg, uint rm, bool wide );
+	void mem( uint reg, int disp );
+	void memIndexed( uint reg, int disp );
+	void load( uint reg, int disp );
+	void loadIndexed( uint reg, int disp );
+	void store( int disp, uint reg );
+	void storeWord( int disp, uint reg );
+	void storeImm( int disp, uchar byte );
+	void storeIndexedImm( int disp, uchar byte );
+	void move( uint dst, uint src );
+	void moveImm( uint reg, uint imm );
+	void movePtr( uint reg, const void *ptr );
+	void alu( uint op, uint dst, uint src );
+	void aluImm( uint op, uint reg, uint imm );
+	void shift( uint op, uint reg, uchar n );
+	void zeroExtend( uint reg );
+	void setcc( uint cc, uint reg );
+	void moveCpu( uint reg );
+	uchar *jump( uint cc );
+	void patch( uchar *from );
+	void call( const void *func );
+	void epilog();
+
+	// TMS7000 state
+	int regOffset( int opn, uchar byte );
+	void value( uint reg, int opn, uchar byte );
+	void setnz( uint reg );
+	void setc( uint reg );
+	void setcNoBorrow();
+	void clearc();
+
+	// Exits and callouts
+	void leave( int pc, uint extra = 0 );
+	void address( int opn, const uchar *opnd );
+	void callMemory( bool write );
+	void exec( const op_t &op );
+
+	// Compile an instruction; returns false if it ends the code
+	bool instruction( const op_t &op );
+
+	// Make the code buffer writable or executable. On failure, releases the
+	// buffer and returns false.
+	bool protect( bool exec );
+
+	// Release the code buffer
+	void release();
+
+	context_t		context_;
+	uchar			*buffer_;
+	uint			size_;
+	uint			used_;
+	uchar			*code_;					///< emitting pointer
+	uint			count_;					///< instructions compiled
+	uint			fetched_;				///< opcode fetches accounted
+	uint			cycles_;				///< cycles of the instructions
+};
@@ -0,0 +1,531 @@
+/*
+    CTS256A-AL2 - TMS7000 CPU Emulator - Opcode Handlers.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// TMS7000 opcode handlers
+//
+// Shared by the interpreter (TMS7000CPU.cpp) and by the code generators
+// (recomp7000, TMS7000Jit), which use the same instruction table and cycle
+// counts to translate the instructions.
+
+#ifdef _MSC_VER
+#pragma warning(disable:4244)	// warning C4244: '%0' : conversion from '%1' to '%2', possible loss of data
+#endif
+
+#include "TMS7000CPU.h"
+
+//  Enumerated constants for instructions, also array subscripts
+enum {
+	ADC=0,	ADD,	AND,	ANDP,	BTJO,	BTJOP,	BTJZ,	BTJZP,
+	BR,		CALL,	CLR,	CLRC,	CMP,	CMPA,	DAC,	DEC,
+	DECD,	DINT,	DJNZ,	DSB,	EINT,	IDLE,	INC,	INV,
+	JMP,	JN,		JZ,		JC,		JP,		JPZ,	JNZ,	JNC,
+	LDA,	LDSP,	MOV,	MOVD,	MOVP,	MPY,	NOP,	OR,
+	ORP,	POP,	PUSH,	RETI,	RETS,	RL,		RLC,	RR,
+	RRC,	SBB,	SETC,	STA,	STSP,	SUB,	SWAP,	TRAP,
+	TSTA,	TSTB,	XCHB,	XOR,	XORP,	DB
+	};
+
+
+//  Enumerated constants for operands, also array subscripts
+enum {		// operand (0=none)
+	A=1, 	// A
+	B, 		// B
+	RN, 	// Rn
+	PN, 	// Pn
+	BYTE,	// %>byte
+	WORD,	// %>word
+	WORD_B, // %>word(B)
+	OFST, 	// PC+offs
+	ADDR, 	// @>addr
+	ADDR_B, // @>addr(B)
+	ATRN, 	// *Rn
+	ST, 	// ST
+	N, 		// ??
+	NTRAP, 	// TRAP n
+	OPCODE	// DB opcode
+	};
+
+
+// Instruction cycles, from the TMS7000 data manual instruction set summary.
+// Conditional jumps take 2 more cycles when the jump is taken.
+constexpr int instrCycles( int mnemon, int opn1, int opn2 )
+{
+	// Dual operand group, by addressing mode
+	int dual =
+		opn1 == B && opn2 == A		? 5 :
+		opn1 == A && opn2 == B		? 6 :
+		opn1 == A && opn2 == RN		? 8 :
+		opn1 == B && opn2 == RN		? 7 :
+		opn1 == RN && opn2 == RN	? 10 :
+		opn1 == RN					? 8 :
+		opn1 == BYTE && opn2 == RN	? 9 :
+		opn1 == BYTE				? 7 : 0;
+
+	// Peripheral group, by addressing mode
+	int periph =
+		opn1 == A					? 10 :
+		opn1 == B					? 9 :
+		opn1 == BYTE				? 11 : 0;
+
+	// Single operand group, by addressing mode
+	int single = opn1 == RN ? 7 : 5;
+
+	// Extended addressing group: @>addr, @>addr(B), *Rn
+	int ext =
+		opn1 == ADDR				? 0 :
+		opn1 == ADDR_B				? 2 : -1;
+
+	switch ( mnemon )
+	{
+	case ADC:	case ADD:	case AND:	case CMP:	case OR:	case SBB:
+	case SUB:	case XOR:	case MOV:
+		return dual;
+	case DAC:	case DSB:
+		return dual + 2;
+	case MPY:
+		return dual + 39 - ( opn1 == B ? 0 : 1 );
+	case BTJO:	case BTJZ:
+		return opn1 == BYTE ? dual + 2 : opn1 == RN && opn2 == RN ? 12 : 10;
+	case ANDP:	case ORP:	case XORP:
+		return periph;
+	case MOVP:
+		return opn2 == PN ? ( opn1 == B ? 10 : periph ) : opn2 == A ? 9 : 8;
+	case BTJOP:	case BTJZP:
+		return periph + 1;
+	case CLR:	case DEC:	case INC:	case INV:	case RL:	case RLC:
+	case RR:	case RRC:
+		return single;
+	case SWAP:
+		return single + 3;
+	case DECD:
+		return single + 4;
+	case DJNZ:
+		return single + 2;
+	case XCHB:
+		return single + 1;
+	case PUSH:	case POP:
+		return opn1 == RN ? 8 : 6;
+	case MOVD:
+		return opn1 == RN ? 14 : opn1 == WORD ? 15 : 17;
+	case LDA:	case STA:
+		return 11 + ext;
+	case CMPA:
+		return 12 + ext;
+	case BR:
+		return 10 + ext;
+	case CALL:
+		return 13 + ext;
+	case JMP:
+		return 7;
+	case JN:	case JZ:	case JC:	case JP:	case JPZ:	case JNZ:	case JNC:
+		return 5;
+	case CLRC:	case TSTA:	case TSTB:	case IDLE:	case STSP:
+		return 6;
+	case SETC:	case RETS:
+		return 7;
+	case DINT:	case EINT:	case LDSP:
+		return 5;
+	case NOP:
+		return 4;
+	case RETI:
+		return 9;
+	case TRAP:
+		return 14;
+	default:
+		return 0;
+	}
+}
+
+
+// Decode one operand. OPN is the addressing mode from instrTable, resolved
+// at compile time so that each handler only contains its own decoding code.
+template<int OPN, bool CACHED>
+inline void TMS7000CPU::operand( const uchar opCode, uchar *&pOpn, uchar &opn, ushort &word )
+{
+	uchar byte;
+
+	if constexpr ( OPN == 0 )			// No operand
+		;
+	else if constexpr ( OPN == A )		// A
+		pOpn = this->a;
+	else if constexpr ( OPN == B )		// B
+		pOpn = this->b;
+	else if constexpr ( OPN == RN )		// Rn
+		pOpn = this->data + opfetch<CACHED>();
+	else if constexpr ( OPN == PN )		// Pn
+		opn = opfetch<CACHED>();
+	else if constexpr ( OPN == BYTE )	// %>byte
+		opn = opfetch<CACHED>();
+	else if constexpr ( OPN == WORD )	// %>word
+		word = opladdr<CACHED>();
+	else if constexpr ( OPN == WORD_B )	// %>word(B)
+		word = opladdr<CACHED>()+*b;
+	else if constexpr ( OPN == OFST )	// PC+offs
+		word = opsaddr<CACHED>();
+	else if constexpr ( OPN == ADDR )	// @>addr
+		word = opladdr<CACHED>();
+	else if constexpr ( OPN == ADDR_B )	// &>addr(B)
+		word = opladdr<CACHED>()+*b;
+	else if constexpr ( OPN == ATRN )	// *Rn
+	{
+		byte = opfetch<CACHED>();
+		word = ( data[uchar(byte-1)] << 8 ) + data[byte];
+	}
+	else if constexpr ( OPN == ST )		// ST
+		opn = getst();
+	else if constexpr ( OPN == N )		// ??
+		;
+	else if constexpr ( OPN == NTRAP )	// TRAP n
+	{
+		word = 0xFFFE - ( ( 0xFF - opCode ) << 1 );
+		word = ( this->getdata( word ) << 8 ) | this->getdata( word + 1 );
+	}
+	else								// DB opcode
+		stop();
+
+	if ( pOpn )
+		opn = *pOpn;
+}
+
+// Opcode handler, instantiated once per (mnemon, opn1, opn2) triple of instrTable.
+// CACHED handlers take their operand bytes from the pre-decoded micro-op (opnd_)
+// instead of fetching them from the bus.
+// Instructions not yet implemented have a "stop();" line.
+template<int MNEMON, int OPN1, int OPN2, bool CACHED>
+void TMS7000CPU::exec( const uchar opCode )
+{
+	uchar *pOpn1 = 0, *pOpn2 = 0;
+	uchar opn1 = 0, opn2 = 0;
+	ushort res;
+	ushort word = 0;
+
+	cycles += instrCycles( MNEMON, OPN1, OPN2 );
+
+	operand<OPN1, CACHED>( opCode, pOpn1, opn1, word );
+	operand<OPN2, CACHED>( opCode, pOpn2, opn2, word );
+
+	if constexpr ( MNEMON == ADC )			// Add with carry
+	{
+		res = opn2 + opn1 + getc();
+		opn2 = res;
+		setcnz( ( res >> 8 ) & 1, res, opn2 );
+		pOpn1 = 0;
+	}
+	else if constexpr ( MNEMON == ADD )		// Add
+	{
+		res = opn2 + opn1;
+		opn2 = res;
+		setcnz( ( res >> 8 ) & 1, res, opn2 );
+		pOpn1 = 0;
+	}
+	else if constexpr ( MNEMON == AND )		// Logical AND
+	{
+		res = opn2 & opn1;
+		opn2 = res;
+		setcnz( 0, res, opn2 );
+		pOpn1 = 0;
+	}
+	else if constexpr ( MNEMON == ANDP )	// AND peripheral register
+	{
+		res = indata( opn2 ) & opn1;
+		outdata( opn2, res );
+		setcnz( 0, res, opn2 );
+		pOpn1 = 0;
+	}
+	else if constexpr ( MNEMON == BTJO )	// Bit test and jump if one
+	{
+		word = opsaddr<CACHED>();
+		if ( opn1 & opn2 )
+		{
+			pc_ = word;
+			cycles += 2;
+		}
+		pOpn1 = pOpn2 = 0;
+	}
+	else if constexpr ( MNEMON == BTJZ )	// Bit test and jump if zero
+	{
+		word = opsaddr<CACHED>();
+		if ( opn1 & ~opn2 )
+		{
+			pc_ = word;
+			cycles += 2;
+		}
+		pOpn1 = pOpn2 = 0;
+	}
+	else if constexpr ( MNEMON == BR )		// Branch
+	{
+		pc_ = word;
+	}
+	else if constexpr ( MNEMON == CALL )
+	{
+		data[++sp] = pc_ >> 8;
+		data[++sp] = pc_ & 0xFF;
+		pc_ = word;
+	}
+	else if constexpr ( MNEMON == CLR )		// Clear
+	{
+		opn1 = 0;
+		setcnz( 0, 0, 0 );
+	}
+	else if constexpr ( MNEMON == CMP )		// Compare
+	{
+		res = opn2 - opn1;
+		setcnz( ( res >> 8 ) ^ 1, res, res ); // !! c == 0 if borrow !!
+		pOpn1 = pOpn2 = 0;
+	}
+	else if constexpr ( MNEMON == CMPA )
+	{
+		res = read( word );
+		res = *a - res;
+		setcnz( ( res >> 8 ) ^ 1, res, res ); // !! c == 0 if borrow !!
+		pOpn1 = pOpn2 = 0;
+	}
+	else if constexpr ( MNEMON == DEC )		// Decrement
+	{
+		--opn1;
+		setcnz( opn1 != 0xFF, opn1, opn1 );
+	}
+	else if constexpr ( MNEMON == DECD )	// Decrement double
+	{
+		--opn1;
+		--pOpn1;
+		if ( opn1 == 0xFF )
+		{
+			--*pOpn1;
+			setc( *pOpn1 != 0xFF );
+		}
+		setnz( *pOpn1, *pOpn1 );
+		++pOpn1;
+	}
+	else if constexpr ( MNEMON == EINT )	// Enable interrupts
+	{
+		setst( getst() | 0xF0 );
+	}
+	else if constexpr ( MNEMON == INC )		// Increment
+	{
+		++opn1;
+		setcnz( opn1 == 0, opn1, opn1 );
+	}
+	else if constexpr ( MNEMON == JMP )		// Jump Unconditional
+	{
+		pc_ = word;
+	}
+	else if constexpr ( MNEMON == JN )		// Jump if negative (CNZ=x1x)
+	{
+		if ( getn() )
+		{
+			pc_ = word;
+			cycles += 2;
+		}
+	}
+	else if constexpr ( MNEMON == JZ )		// Jump if zero <=> JEQ=Jump if equal (CNZ=xx1)
+	{
+		if ( getz() )
+		{
+			pc_ = word;
+			cycles += 2;
+		}
+	}
+	else if constexpr ( MNEMON == JP )		// Jump if positive (CNZ=x00)
+	{
+		if ( !getn() && !getz() )
+		{
+			pc_ = word;
+			cycles += 2;
+		}
+	}
+	else if constexpr ( MNEMON == JPZ )		// Jump if positive or zero (CNZ=x0x)
+	{
+		if ( !getn() )
+		{
+			pc_ = word;
+			cycles += 2;
+		}
+	}
+	else if constexpr ( MNEMON == JNZ )		// Jump if non-zero <=> JNE: Jump if not equal (CNZ=xx0)
+	{
+		if ( !getz() )
+		{
+			pc_ = word;
+			cycles += 2;
+		}
+	}
+	else if constexpr ( MNEMON == JNC )		// Jump if no carry <=> JL=Jump if lower (CNZ=0xx)
+	{
+		if ( !getc() )
+		{
+			pc_ = word;
+			cycles += 2;
+		}
+	}
+	else if constexpr ( MNEMON == LDA )		// Load register A
+	{
+		*a = res = read( word );
+		setcnz( 0, res, res );
+	}
+	else if constexpr ( MNEMON == LDSP )	// Load Stack Pointer
+	{
+		this->sp = *b;
+	}
+	else if constexpr ( MNEMON == MOV )		// Move
+	{
+		opn2 = opn1;
+		setcnz( 0, opn2, opn2 );
+		pOpn1 = 0;
+	}
+	else if constexpr ( MNEMON == MOVD )	// Move double
+	{
+		if ( pOpn1 )
+		{
+			word = ( *(pOpn1-1) << 8 ) | *pOpn1;
+			pOpn1 = 0;
+		}
+
+		if ( pOpn2 )
+		{
+			*(pOpn2-1) = res = word >> 8;
+			*pOpn2 = word & 0xFF;
+			pOpn2 = 0;
+			setcnz( 0, res, res );
+		}
+		else
+		{
+			stop(); // should not happen
+		}
+	}
+	else if constexpr ( MNEMON == MOVP )	// Move to/from peripheral register
+	{
+		if constexpr ( OPN1 == PN )
+			opn1 = this->indata( opn1 );
+
+		setcnz( 0, opn1, opn1 );
+
+		if constexpr ( OPN2 == PN )
+		{
+			this->outdata( opn2, opn1 );
+			pOpn2 = 0;
+		}
+		else
+		{
+			opn2 = opn1;
+		}
+
+		pOpn1 = 0;
+	}
+	else if constexpr ( MNEMON == MPY )		// Multiply
+	{
+		res = opn1 * opn2;
+		*a = res >> 8;
+		*b = res & 0xFF;
+		setcnz( 0, *a, *a );
+		pOpn1 = pOpn2 = 0;
+	}
+	else if constexpr ( MNEMON == OR )		// Logical OR
+	{
+		res = opn2 | opn1;
+		opn2 = res;
+		setcnz( 0, res, opn2 );
+		pOpn1 = 0;
+	}
+	else if constexpr ( MNEMON == ORP )		// OR peripheral register
+	{
+		res = indata( opn2 ) | opn1;
+		outdata( opn2, res );
+		setcnz( 0, res, opn2 );
+		pOpn1 = 0;
+	}
+	else if constexpr ( MNEMON == POP )		// Pop from stack
+	{
+		opn1 = data[sp--];
+	}
+	else if constexpr ( MNEMON == PUSH )	// Push on stack
+	{
+		data[++sp] = opn1;
+		pOpn1 = 0;
+	}
+	else if constexpr ( MNEMON == RETI )	// Return from interrupt
+	{
+		pc_ = data[sp--];
+		pc_ |= data[sp--] << 8;
+		setst( data[sp--] );
+	}
+	else if constexpr ( MNEMON == RETS )	// Return from subroutine
+	{
+		pc_ = data[sp--];
+		pc_ |= data[sp--] << 8;
+	}
+	else if constexpr ( MNEMON == RRC )		// Rotate right through carry
+	{
+		res = ( opn1 >> 1 ) | ( getc() << 7 );
+		setcnz( opn1 & 1, res, res );
+		opn1 = res;
+	}
+	else if constexpr ( MNEMON == SBB )		// Subtract with borrow
+	{
+		res = opn2 - opn1 - 1 + getc();
+		opn2 = res;
+		setcnz( ( res >> 8 ) ^ 1, res, res ); // !! c == 0 if borrow !!
+		pOpn1 = 0;
+	}
+	else if constexpr ( MNEMON == STA )		// Store register A
+	{
+		write( word, res = *a );
+		setcnz( 0, res, res );
+	}
+	else if constexpr ( MNEMON == SUB )		// Subtract
+	{
+		res = opn2 - opn1;
+		opn2 = res;
+		setcnz( ( res >> 8 ) ^ 1, res, res ); // !! c == 0 if borrow !!
+		pOpn1 = 0;
+	}
+	else if constexpr ( MNEMON == SWAP )
+	{
+		opn1 = ( opn1 >> 4 ) | ( opn1 << 4 );
+		setcnz( opn1 & 1, opn1, opn1 );
+	}
+	else if constexpr ( MNEMON == TSTA )	// Test register A <=> CLRC=Clear carry
+	{
+		setcnz( 0, *a, *a );
+	}
+	else
+	{
+		// BTJOP, BTJZP, CLRC, DAC, DINT, DJNZ, DSB, IDLE, INV, JC, NOP, RL,
+		// RLC, RR, SETC, STSP, TRAP, TSTB, XCHB, XOR, XORP, DB
+		stop();
+	}
+
+	if ( pOpn1 )
+		*pOpn1 = opn1;
+
+	if ( pOpn2 )
+		*pOpn2 = opn2;
+
+	// Setting the I flag is an event for the interrupt lines
+	if constexpr ( MNEMON == EINT || MNEMON == RETI || ( MNEMON == POP && OPN1 == ST ) )
+		intevent_ = true;
+}
@@ -0,0 +1,35 @@
+# CTS256A-AL2 emulator benchmark
+#
+# Converts the corpus with the -s switch and prints the emulation statistics
+# of each run. The allophone output is discarded.
+#
+#   cmake -DEXE=<cts256a-al2> -DCORPUS=<text file> [-DARGS=<options>]
+#         [-DRUNS=<count>] -P bench.cmake
+#
+# ARGS is a ;-separated list of extra emulator options, RUNS the number of
+# runs (default 3). The "bench" target runs it on bench/corpus.txt.
+
+if(NOT EXE OR NOT CORPUS)
+    message(FATAL_ERROR "usage: cmake -DEXE=<cts256a-al2> -DCORPUS=<text file> [-DARGS=<options>] [-DRUNS=<count>] -P bench.cmake")
+endif()
+
+if(NOT RUNS)
+    set(RUNS 3)
+endif()
+
+set(command ${EXE} -s ${ARGS} -i${CORPUS})
+string(REPLACE ";" " " line "${command}")
+message("${line}\n")
+
+foreach(run RANGE 1 ${RUNS})
+    execute_process(
+        COMMAND ${command}
+        OUTPUT_QUIET
+        ERROR_VARIABLE stats
+        RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${EXE} failed: ${result}")
+    endif()
+    string(STRIP "${stats}" stats)
+    message("Run ${run}/${RUNS}\n${stats}\n")
+endforeach()
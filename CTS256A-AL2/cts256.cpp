@@ -0,0 +1,472 @@
+/*
+    CTS256A-AL2 - Text-To-Allophones Library.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "cts256.h"
+#include "cts256cache.h"
+#include "cts256rules.h"
+#include "CTS256A_AL2_Data_InOut.h"
+#include "CTS256A_AL2_HLE.h"
+#include "CTS256A_AL2_Recompiled.h"
+#include "TMS7000Core.h"
+
+#include <algorithm>
+#include <streambuf>
+
+// Number of RUN_CYCLES runs without input or output before a conversion is
+// reported stalled: well above the EOF counter (EOF_CTR_RELOAD reads)
+#define STALL_SLICES 1000
+
+static_assert( CTS256::ROUTINE_SCAN == HLE_SCAN && CTS256::ROUTINE_BRACKET == HLE_BRACKET
+	&& CTS256::ROUTINE_READ == HLE_READ && CTS256::ROUTINES_CHECK == HLE_CHECK,
+	"CTS256 routines mask" );
+
+// Input stream buffer reading the text in place
+class TextBuffer : public std::streambuf
+{
+public:
+	void setText( std::string_view text )
+	{
+		char *begin = const_cast<char*>( text.data() );
+		setg( begin, begin, begin + text.size() );
+	}
+};
+
+static void appendAllophone( void *object, uint8_t allophone )
+{
+	( (std::vector<uint8_t>*)object )->push_back( allophone );
+}
+
+// Count the utterances of a text, as the board does: a line ends at a CR,
+// or at a LF not preceded by a CR, and a last line without line end counts
+static uint64_t countUtterances( std::string_view text )
+{
+	uint64_t utterances = 0;
+	char last = 0;
+
+	for ( char c : text )
+	{
+		if ( c == '\r' || ( c == '\n' && last != '\r' ) )
+			++utterances;
+		last = c;
+	}
+
+	if ( last && last != '\r' && last != '\n' )
+		++utterances;
+
+	return utterances;
+}
+
+// The emulated CTS256A-AL2, and its state after the ROM init
+struct CTS256::Machine
+{
+	typedef CTS256A_AL2_Data_InOut<CTS256A_AL2_Release> Board;
+
+	Machine( std::vector<uchar> &&exceptionRom, ushort romAddress )
+	: istr_( &text_ ), ostr_( 0 ),
+		data_( cpu_, istr_, ostr_, std::move( exceptionRom ), romAddress ),
+		hle_( cpu_, data_ ), instructions_( 0 ), cycles_( 0 ), utterances_( 0 ), hooked_( false ),
+		verify_( 0 ), verifyCtr_( 0 ), bypassed_( 0 ), verified_( 0 ), mismatches_( 0 ),
+		allophoneCtr_( 0 ), native_( false ), nativeVerify_( 0 ), nativeVerifyCtr_( 0 ),
+		nativeConverted_( 0 ), nativeBypassed_( 0 ), nativeVerified_( 0 ), nativeMismatches_( 0 )
+	{
+		cpu_.setBus( &data_ );
+		cpu_.setMode( &mode_ );
+
+		// The CTS256A-AL2 ROM and the exception ROM are immutable code
+		cpu_.addCodeCache( 0xF000, 0x1000 );
+		if ( data_.getRomSize() )
+			cpu_.addCodeCache( data_.getRomAddress(),
+				data_.getRomSize() < 0x1000 ? data_.getRomSize() : 0x1000 );
+
+		// No 'O.K.'
+		data_.setOption( 'N', 1 );
+
+		// Hot ROM subroutines run natively
+		hle_.setRoutines( HLE_ALL );
+
+		// Run the ROM init up to the first input poll
+		cpu_.reset();
+		mode_.setMode( MODE_RUN );
+
+		while ( mode_.getMode() == MODE_RUN && !data_.isInputPoll( cpu_.getPC() ) )
+			cpu_.simblock();
+
+		cpu_.getState( cpuState_ );
+		data_.getState( dataState_ );
+	}
+
+	// Convert the text, from the state after the init
+	bool emulate( std::string_view text, allophone_t handler, void *object )
+	{
+		text_.setText( text );
+		istr_.clear();
+
+		data_.setAllophoneWriter( handler, object );
+		data_.setState( dataState_ );
+		cpu_.setState( cpuState_ );
+		mode_.setMode( MODE_RUN );
+
+		wordStarts_.clear();
+		allophoneCtr_ = 0;
+
+		// Recompiled ROM code, else interpreted code (exception ROM). The
+		// release board has no debug watchdog: stalled after STALL_SLICES
+		// runs without input or output
+		ulong io = data_.getIOCount();
+		uint idle = 0;
+
+		while ( mode_.getMode() == MODE_RUN && idle < STALL_SLICES )
+		{
+			cpu_.runRecompiled( RUN_CYCLES );
+
+			if ( data_.getIOCount() != io )
+			{
+				io = data_.getIOCount();
+				idle = 0;
+			}
+			else
+				++idle;
+		}
+
+		instructions_ += cpu_.getInstructions() - cpuState_.instructions;
+		cycles_ += cpu_.getCycles() - cpuState_.cycles;
+
+		// Stopped by the end of input, or stalled
+		return mode_.getMode() == MODE_EXIT;
+	}
+
+	// Convert the text with the emulator only
+	bool run( std::string_view text, allophone_t handler, void *object )
+	{
+		bool ok = emulate( text, handler, object );
+		utterances_ += data_.getUtterances() - dataState_.utterances;
+		return ok;
+	}
+
+	// Cache the allophones of up to entries words; the rules of an
+	// exception ROM are not scanned: no cache
+	void setCache( size_t entries, uint32_t verify )
+	{
+		cache_.setCapacity( data_.getRomSize() ? 0 : entries );
+		verify_ = verify;
+
+		if ( cache_.getCapacity() && !hooked_ )
+		{
+			data_.addHook( 0xF3E7, wordHook, this );
+			data_.addHook( 0xF4B3, allophoneHook, this );
+			hooked_ = true;
+		}
+	}
+
+	// Convert with the rules extracted from the ROMs, built once
+	void setNative( bool native, uint32_t verify )
+	{
+		if ( native && !rules_ )
+			rules_.reset( new CTS256Rules( data_.getExceptionRom(), data_.getRomAddress() ) );
+
+		native_ = native;
+		nativeVerify_ = verify;
+	}
+
+	// F3E7: conversion of a word, after the allophones counted so far
+	static void wordHook( void *object, ushort /*addr*/ )
+	{
+		Machine *machine = (Machine*)object;
+		machine->wordStarts_.push_back( machine->allophoneCtr_ );
+	}
+
+	// F4B3: allophone stored into the output buffer
+	static void allophoneHook( void *object, ushort /*addr*/ )
+	{
+		++( (Machine*)object )->allophoneCtr_;
+	}
+
+	// Check the allophones of the text from first against the emulator,
+	// and replace them if different
+	bool check( std::string_view text, std::vector<uint8_t> &allophones, size_t first, uint64_t &mismatches )
+	{
+		output_.clear();
+		bool ok = emulate( text, appendAllophone, &output_ );
+
+		if ( !ok || output_.size() != allophones.size() - first
+			|| !std::equal( output_.begin(), output_.end(), allophones.begin() + first ) )
+		{
+			++mismatches;
+			allophones.resize( first );
+			allophones.insert( allophones.end(), output_.begin(), output_.end() );
+			return ok;
+		}
+
+		return true;
+	}
+
+	// Convert the text with the native engine, else with the cache
+	bool translate( std::string_view text, std::vector<uint8_t> &allophones )
+	{
+		if ( !native_ )
+			return translateCached( text, allophones );
+
+		size_t first = allophones.size();
+
+		if ( !rules_->translate( text, allophones ) )
+		{
+			++nativeBypassed_;
+			return translateCached( text, allophones );
+		}
+
+		++nativeConverted_;
+		utterances_ += countUtterances( text );
+
+		// Check a sample of the texts against the emulator
+		if ( nativeVerify_ && ++nativeVerifyCtr_ >= nativeVerify_ )
+		{
+			nativeVerifyCtr_ = 0;
+			++nativeVerified_;
+			return check( text, allophones, first, nativeMismatches_ );
+		}
+
+		return true;
+	}
+
+	// Convert the text with the cached words, and the emulator for the others
+	bool translateCached( std::string_view text, std::vector<uint8_t> &allophones )
+	{
+		if ( !cache_.getCapacity() )
+			return run( text, appendAllophone, &allophones );
+
+		if ( !cache_.split( text, chars_, words_ ) )
+		{
+			++bypassed_;
+			return run( text, appendAllophone, &allophones );
+		}
+
+		size_t count = words_.size();
+		bool hit = false;
+
+		keys_.resize( count );
+		results_.resize( count );
+		found_.assign( count, false );
+
+		for ( size_t i = 0; i < count; ++i )
+		{
+			const CTS256Cache::word_t &word = words_[i];
+			keys_[i].assign( chars_, word.begin, word.keyEnd - word.begin );
+
+			if ( const std::vector<uint8_t> *cached = cache_.find( keys_[i] ) )
+			{
+				results_[i] = *cached;
+				found_[i] = true;
+				hit = true;
+			}
+		}
+
+		// Convert each run of words not cached, with the characters seen
+		// after them; the allophones stored between two calls of the word
+		// routine are those of a word
+		for ( size_t i = 0; i < count; )
+		{
+			if ( found_[i] )
+			{
+				++i;
+				continue;
+			}
+
+			size_t end = i + 1;
+			while ( end < count && !found_[end] )
+				++end;
+
+			std::string_view chars( chars_.data() + words_[i].begin, words_[end - 1].keyEnd - words_[i].begin );
+
+			output_.clear();
+
+			if ( !emulate( chars, appendAllophone, &output_ ) || wordStarts_.size() < end - i
+				|| allophoneCtr_ != output_.size() )
+			{
+				// Stalled, or not converted word by word: no cache
+				++bypassed_;
+				return run( text, appendAllophone, &allophones );
+			}
+
+			for ( size_t j = i; j < end; ++j )
+			{
+				size_t first = wordStarts_[j - i];
+				size_t last = j + 1 - i < wordStarts_.size() ? wordStarts_[j + 1 - i] : output_.size();
+
+				results_[j].assign( output_.begin() + first, output_.begin() + last );
+				cache_.insert( keys_[j], std::vector<uint8_t>( results_[j] ) );
+			}
+
+			i = end;
+		}
+
+		size_t first = allophones.size();
+
+		for ( size_t i = 0; i < count; ++i )
+			allophones.insert( allophones.end(), results_[i].begin(), results_[i].end() );
+
+		utterances_ += countUtterances( text );
+
+		// Check a sample of the texts with cached words against the emulator
+		if ( hit && verify_ && ++verifyCtr_ >= verify_ )
+		{
+			verifyCtr_ = 0;
+			++verified_;
+			return check( text, allophones, first, mismatches_ );
+		}
+
+		return true;
+	}
+
+	TextBuffer								text_;
+	std::istream							istr_;
+	std::ostream							ostr_;			///< unused
+	TMS7000Core<Board>						cpu_;
+	Board									data_;
+	CTS256A_AL2_HLE							hle_;
+	Mode									mode_;
+	TMS7000CPU::state_t						cpuState_;
+	Board::state_t							dataState_;
+	uint64_t								instructions_;
+	uint64_t								cycles_;
+	uint64_t								utterances_;
+
+	// Word cache
+	CTS256Cache								cache_;
+	bool									hooked_;
+	uint32_t								verify_;		///< check 1 text in verify_
+	uint32_t								verifyCtr_;
+	uint64_t								bypassed_;
+	uint64_t								verified_;
+	uint64_t								mismatches_;
+	std::vector<uint>						wordStarts_;	///< allophones before each word
+	uint									allophoneCtr_;	///< allophones stored
+	std::string								chars_;
+	std::vector<CTS256Cache::word_t>		words_;
+	std::vector<std::string>				keys_;
+	std::vector<std::vector<uint8_t>>		results_;
+	std::vector<bool>						found_;
+	std::vector<uint8_t>					output_;
+
+	// Native rule engine
+	std::unique_ptr<CTS256Rules>			rules_;
+	bool									native_;
+	uint32_t								nativeVerify_;	///< check 1 text in nativeVerify_
+	uint32_t								nativeVerifyCtr_;
+	uint64_t								nativeConverted_;
+	uint64_t								nativeBypassed_;
+	uint64_t								nativeVerified_;
+	uint64_t								nativeMismatches_;
+};
+
+CTS256::CTS256()
+: machine_( new Machine( std::vector<uchar>(), 0 ) )
+{
+}
+
+CTS256::CTS256( std::vector<uint8_t> &&exceptionRom, uint16_t romAddress )
+: machine_( new Machine( std::move( exceptionRom ), romAddress ) )
+{
+}
+
+CTS256::~CTS256()
+{
+}
+
+bool CTS256::translate( std::string_view text, std::vector<uint8_t> &allophones )
+{
+	return machine_->translate( text, allophones );
+}
+
+bool CTS256::translate( std::string_view text, allophone_t handler, void *object )
+{
+	if ( !machine_->cache_.getCapacity() && !machine_->native_ )
+		return machine_->run( text, handler, object );
+
+	std::vector<uint8_t> allophones;
+	bool ok = machine_->translate( text, allophones );
+
+	for ( uint8_t allophone : allophones )
+		handler( object, allophone );
+
+	return ok;
+}
+
+const char *CTS256::getLabel( uint8_t allophone )
+{
+	return CTS256A_AL2_Board_I::getAllophoneLabel( allophone );
+}
+
+uint64_t CTS256::getInstructions() const
+{
+	return machine_->instructions_;
+}
+
+uint64_t CTS256::getCycles() const
+{
+	return machine_->cycles_;
+}
+
+uint64_t CTS256::getUtterances() const
+{
+	return machine_->utterances_;
+}
+
+void CTS256::setCache( size_t entries, uint32_t verify )
+{
+	machine_->setCache( entries, verify );
+}
+
+CTS256::cacheStats_t CTS256::getCacheStats() const
+{
+	const Machine &machine = *machine_;
+
+	return { machine.cache_.getHits(), machine.cache_.getMisses(), machine.cache_.getEvictions(),
+		machine.bypassed_, machine.verified_, machine.mismatches_ };
+}
+
+void CTS256::setNative( bool native, uint32_t verify )
+{
+	machine_->setNative( native, verify );
+}
+
+CTS256::nativeStats_t CTS256::getNativeStats() const
+{
+	const Machine &machine = *machine_;
+
+	return { machine.nativeConverted_, machine.nativeBypassed_, machine.nativeVerified_,
+		machine.nativeMismatches_ };
+}
+
+void CTS256::setHLE( uint32_t routines )
+{
+	machine_->hle_.setRoutines( routines );
+}
+
+CTS256::hleStats_t CTS256::getHLEStats() const
+{
+	const CTS256A_AL2_HLE &hle = machine_->hle_;
+
+	return { hle.getCalls(), hle.getChecks(), hle.getMismatches() };
+}
@@ -0,0 +1,132 @@
+/*
+    CTS256A-AL2 - Text-To-Allophones Library.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Text to SP0256-AL2 allophones conversion by the emulated CTS256A-AL2,
+// without console or debugger. The ROM init is run once by the constructor;
+// each conversion restarts from the machine state after the init.
+// An instance converts one text at a time: use one instance per thread.
+class CTS256
+{
+public:
+	// Allophone handler, called with each allophone code (00..3F) as the
+	// ROM outputs it
+	typedef void (*allophone_t)( void *object, uint8_t allophone );
+
+	CTS256();
+
+	// With the exception ROM image located at romAddress (1000..E000)
+	CTS256( std::vector<uint8_t> &&exceptionRom, uint16_t romAddress );
+
+	~CTS256();
+
+	// Convert the text, appending the allophone codes to allophones;
+	// returns false if the ROM stalled before the end of the conversion
+	bool translate( std::string_view text, std::vector<uint8_t> &allophones );
+
+	// Convert the text, calling handler for each allophone
+	bool translate( std::string_view text, allophone_t handler, void *object );
+
+	// Get the label of an allophone code (PA1, OY, AY, ...)
+	static const char *getLabel( uint8_t allophone );
+
+	// Get the number of emulated instructions, cycles and utterances of all
+	// the conversions
+	uint64_t getInstructions() const;
+	uint64_t getCycles() const;
+	uint64_t getUtterances() const;
+
+	// Word cache statistics
+	struct cacheStats_t
+	{
+		uint64_t	hits;			///< words found in the cache
+		uint64_t	misses;			///< words converted by the emulator
+		uint64_t	evictions;		///< least recently used words dropped
+		uint64_t	bypassed;		///< texts converted without the cache
+		uint64_t	verified;		///< texts checked against the emulator
+		uint64_t	mismatches;		///< checked texts converted differently
+	};
+
+	// Cache the allophones of up to entries words (0: no cache), and check 1
+	// in verify texts with cached words against the emulator (0: none).
+	// Not available with an exception ROM.
+	void setCache( size_t entries, uint32_t verify = 0 );
+
+	cacheStats_t getCacheStats() const;
+
+	// Native rule engine statistics
+	struct nativeStats_t
+	{
+		uint64_t	converted;		///< texts converted by the native engine
+		uint64_t	bypassed;		///< texts left to the cache or the emulator
+		uint64_t	verified;		///< texts checked against the emulator
+		uint64_t	mismatches;		///< checked texts converted differently
+	};
+
+	// Convert the texts with the rules extracted from the ROMs, without
+	// emulation; the texts the native engine can't convert as the ROM does
+	// go to the cache or the emulator. Check 1 in verify texts against the
+	// emulator (0: none).
+	void setNative( bool native, uint32_t verify = 0 );
+
+	nativeStats_t getNativeStats() const;
+
+	// ROM subroutines run natively instead of emulated (high-level emulation)
+	enum : uint32_t
+	{
+		ROUTINE_SCAN	= 0x01,		///< rule scan (F488)
+		ROUTINE_BRACKET	= 0x02,		///< rule bracket match (F4C2)
+		ROUTINE_READ	= 0x04,		///< input ring read (F70F)
+		ROUTINES_ALL	= 0x07,
+		ROUTINES_CHECK	= 0x80		///< check each call against the code
+	};
+
+	// Native routines statistics
+	struct hleStats_t
+	{
+		uint64_t	calls;			///< native routine calls
+		uint64_t	checks;			///< calls checked against the code
+		uint64_t	mismatches;		///< checked calls ending in another state
+	};
+
+	// Run the ROM subroutines of the routines mask natively (default:
+	// ROUTINES_ALL); with ROUTINES_CHECK, the code is run after each call
+	// from the same state, and its results are kept
+	void setHLE( uint32_t routines );
+
+	hleStats_t getHLEStats() const;
+
+private:
+	struct Machine;
+
+	std::unique_ptr<Machine>	machine_;
+};
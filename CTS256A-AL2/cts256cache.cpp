@@ -0,0 +1,254 @@
+/*
+    CTS256A-AL2 - Word Cache.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "cts256cache.h"
+#include "CTS256A_AL2_ROM.h"
+
+#include <ctype.h>
+
+// Max number of characters of a cached text, well below the size of the
+// ROM input ring (1792), so that the whole text is stored before converted
+#define CACHE_MAX_TEXT		1024
+
+// Whole next word seen by a rule
+#define NEXT_WORD			size_t( -1 )
+
+// Context of the ROM rules
+struct rulesContext_t
+{
+	bool										supported;	///< contexts up to the adjacent delimiters
+	std::vector<std::pair<std::string, size_t>>	lookahead;	///< characters matched, next word characters seen
+};
+
+// Scan the rules from addr to end; initial is the letter starting the
+// characters matched, 0 for the punctuation and digits
+static void scanRules( ushort addr, ushort end, char initial, rulesContext_t &context )
+{
+	while ( addr < end )
+	{
+		uchar c;
+
+		// Left context: only its first symbol may see the delimiter before
+		// the word
+		for ( bool first = true; !( ( c = CTS256A_AL2_readRom( addr ) ) & RULE_OPEN ); ++addr, first = false )
+		{
+			if ( c == SYMBOL_NONLETTER && !first )
+				context.supported = false;
+		}
+
+		// Characters matched
+		std::string chars;
+
+		if ( initial )
+			chars += initial;
+
+		do
+		{
+			c = CTS256A_AL2_readRom( addr++ );
+			if ( c != RULE_EMPTY )
+				chars += char( ( c & 0x3F ) + 0x20 );
+		} while ( !( c & RULE_CLOSE ) );
+
+		// Right context: the symbols after a '<' see the next word
+		std::vector<uchar> right;
+
+		while ( !( ( c = CTS256A_AL2_readRom( addr ) ) & RULE_OPEN ) )
+		{
+			right.push_back( c );
+			++addr;
+		}
+
+		for ( size_t i = 0; i < right.size(); ++i )
+		{
+			if ( right[i] != SYMBOL_NONLETTER || i == right.size() - 1 )
+				continue;
+
+			// A single symbol, matched by the first character of the next
+			// word, else the whole next word
+			size_t seen = NEXT_WORD;
+			if ( i == right.size() - 2 )
+			{
+				c = right[i + 1];
+				if ( c == SYMBOL_QUOTE || c == SYMBOL_VOWELS || c == SYMBOL_VOICED || c == SYMBOL_CONSONANT
+					|| c == SYMBOL_FRONT || c == SYMBOL_BACK || ( c >= SYMBOL_A && c <= SYMBOL_Z ) )
+					seen = 1;
+			}
+			context.lookahead.push_back( { chars, seen } );
+
+			// A second '<' would see beyond the next word
+			for ( size_t j = i + 1; j < right.size(); ++j )
+			{
+				if ( right[j] == SYMBOL_NONLETTER )
+					context.supported = false;
+			}
+			break;
+		}
+
+		// Allophones
+		do
+		{
+			c = CTS256A_AL2_readRom( addr++ );
+		} while ( !( c & RULE_CLOSE ) );
+	}
+}
+
+static rulesContext_t scanRules()
+{
+	rulesContext_t context = { true, {} };
+
+	ushort letters[27];
+
+	for ( int i = 0; i < 26; ++i )
+		letters[i] = ( CTS256A_AL2_readRom( RULES_LETTERS + 2 * i ) << 8 ) | CTS256A_AL2_readRom( RULES_LETTERS + 2 * i + 1 );
+	letters[26] = RULES_DIGITS;
+
+	scanRules( RULES_PUNCTUATION, letters[0], 0, context );
+	for ( int i = 0; i < 26; ++i )
+		scanRules( letters[i], letters[i + 1], char( 'A' + i ), context );
+	scanRules( RULES_DIGITS, RULES_END, 0, context );
+
+	return context;
+}
+
+// Get the context of the ROM rules, scanned once
+static const rulesContext_t &getRulesContext()
+{
+	static const rulesContext_t context = scanRules();
+	return context;
+}
+
+CTS256Cache::CTS256Cache()
+: capacity_( 0 ), hits_( 0 ), misses_( 0 ), evictions_( 0 )
+{
+}
+
+void CTS256Cache::setCapacity( size_t capacity )
+{
+	capacity_ = capacity;
+
+	while ( entries_.size() > capacity_ )
+	{
+		index_.erase( entries_.back().first );
+		entries_.pop_back();
+		++evictions_;
+	}
+}
+
+// Split the text into words, as stored by the ROM input (F1E2) and converted
+// by the word routine (F3E7). The text must be a single line, so that it is
+// stored entirely before the words are converted: the ROM waits for a CR
+// (F10C); when converting the next lines, their characters may still arrive
+// one by one
+bool CTS256Cache::split( std::string_view text, std::string &chars, std::vector<word_t> &words ) const
+{
+	const rulesContext_t &rules = getRulesContext();
+
+	if ( !rules.supported || text.size() > CACHE_MAX_TEXT )
+		return false;
+
+	chars.clear();
+	words.clear();
+
+	size_t begin = 0;
+
+	for ( char ch : text )
+	{
+		uchar c = uchar( toupper( uchar( ch ) ) );
+
+		// Line end, editing characters (ESC, ^R, backspace)
+		if ( c == 0x0D || c == 0x1B || c == 0x12 || c == 0x08 )
+			return false;
+
+		chars += char( c );
+
+		if ( CTS256A_AL2_isDelimiter( c ) )
+		{
+			words.push_back( { begin, chars.size(), chars.size() } );
+			begin = chars.size();
+		}
+	}
+
+	// CR at the end of input
+	chars += '\r';
+	words.push_back( { begin, chars.size(), chars.size() } );
+
+	// Characters of the next word seen by the rules matching the end of a
+	// word. The last word has none: nothing follows its CR
+	for ( size_t i = 0; i < words.size(); ++i )
+	{
+		word_t &word = words[i];
+		std::string_view letters( chars.data() + word.begin, word.end - 1 - word.begin );
+		size_t seen = 0;
+
+		for ( const auto &lookahead : rules.lookahead )
+		{
+			if ( letters.size() >= lookahead.first.size() && lookahead.second > seen
+				&& !letters.compare( letters.size() - lookahead.first.size(), lookahead.first.size(), lookahead.first ) )
+				seen = lookahead.second;
+		}
+
+		if ( !seen )
+			continue;
+
+		if ( i == words.size() - 1 )
+			return false;
+
+		const word_t &next = words[i + 1];
+		word.keyEnd = seen < next.end - next.begin ? next.begin + seen : next.end;
+	}
+
+	return true;
+}
+
+const std::vector<uint8_t> *CTS256Cache::find( const std::string &key )
+{
+	auto it = index_.find( key );
+
+	if ( it == index_.end() )
+	{
+		++misses_;
+		return 0;
+	}
+
+	entries_.splice( entries_.begin(), entries_, it->second );
+	++hits_;
+	return &it->second->second;
+}
+
+void CTS256Cache::insert( const std::string &key, std::vector<uint8_t> &&allophones )
+{
+	if ( !capacity_ || index_.count( key ) )
+		return;
+
+	if ( entries_.size() >= capacity_ )
+	{
+		index_.erase( entries_.back().first );
+		entries_.pop_back();
+		++evictions_;
+	}
+
+	entries_.emplace_front( key, std::move( allophones ) );
+	index_.emplace( entries_.front().first, entries_.begin() );
+}
@@ -0,0 +1,100 @@
+/*
+    CTS256A-AL2 - Word Cache.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Least recently used cache of the allophones of the ROM words.
+//
+// The ROM converts the input one word at a time (F3E7): the characters up to
+// and including a delimiter. The rules see the characters of the word, and
+// through their context the delimiters around it (a '<' symbol); the rules
+// scanned from the ROM tables tell which words also see the start of the
+// next word, like "THE" before a vowel. The key of a word is its characters,
+// and the characters after it seen by the rules.
+class CTS256Cache
+{
+public:
+	// Word of the text, as converted by the ROM
+	struct word_t
+	{
+		size_t	begin;			///< first character
+		size_t	end;			///< after the delimiter
+		size_t	keyEnd;			///< after the characters seen by the rules
+	};
+
+	CTS256Cache();
+
+	// Set the max number of words (0: no cache)
+	void setCapacity( size_t capacity );
+
+	size_t getCapacity() const
+	{
+		return capacity_;
+	}
+
+	// Split the text into words, with the characters as stored by the ROM
+	// (upper case, CR at the end of input); returns false if the words of the
+	// text can't be cached: several lines, editing characters, long line
+	bool split( std::string_view text, std::string &chars, std::vector<word_t> &words ) const;
+
+	// Find the allophones of a word; 0 if not cached
+	const std::vector<uint8_t> *find( const std::string &key );
+
+	// Cache the allophones of a word, dropping the least recently used one
+	// if full
+	void insert( const std::string &key, std::vector<uint8_t> &&allophones );
+
+	uint64_t getHits() const
+	{
+		return hits_;
+	}
+
+	uint64_t getMisses() const
+	{
+		return misses_;
+	}
+
+	uint64_t getEvictions() const
+	{
+		return evictions_;
+	}
+
+private:
+	typedef std::pair<std::string, std::vector<uint8_t>>	entry_t;
+
+	size_t												capacity_;
+	std::list<entry_t>									entries_;	///< most recently used first
+	std::unordered_map<std::string_view, std::list<entry_t>::iterator>	index_;
+	uint64_t											hits_;
+	uint64_t											misses_;
+	uint64_t											evictions_;
+};
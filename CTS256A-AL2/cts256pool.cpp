@@ -0,0 +1,230 @@
+/*
+    CTS256A-AL2 - Text-To-Allophones Instance Pool.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "cts256pool.h"
+
+// Pending requests per worker: keeps the workers busy while the head
+// request is converted, without reading all the input ahead
+#define REQUESTS_PER_THREAD 16
+
+CTS256Pool::CTS256Pool( uint32_t threads, result_t handler, void *object )
+: handler_( handler ), object_( object ), romAddress_( 0 )
+{
+	start( threads );
+}
+
+CTS256Pool::CTS256Pool( uint32_t threads, result_t handler, void *object,
+	const std::vector<uint8_t> &exceptionRom, uint16_t romAddress )
+: handler_( handler ), object_( object ), exceptionRom_( exceptionRom ),
+	romAddress_( romAddress )
+{
+	start( threads );
+}
+
+CTS256Pool::~CTS256Pool()
+{
+	finish();
+	stop();
+}
+
+void CTS256Pool::start( uint32_t threads )
+{
+	if ( !threads )
+		threads = std::thread::hardware_concurrency();
+	if ( !threads )
+		threads = 1;
+
+	next_ = 0;
+	window_ = threads * REQUESTS_PER_THREAD;
+	stop_ = false;
+	instructions_ = cycles_ = utterances_ = 0;
+	cacheEntries_ = 0;
+	cacheVerify_ = 0;
+	cacheStats_ = {};
+	native_ = false;
+	nativeVerify_ = 0;
+	nativeStats_ = {};
+	hle_ = CTS256::ROUTINES_ALL;
+	hleStats_ = {};
+
+	for ( uint32_t i = 0; i < threads; ++i )
+		threads_.emplace_back( &CTS256Pool::worker, this );
+}
+
+void CTS256Pool::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+		stop_ = true;
+	}
+	queued_.notify_all();
+
+	for ( std::thread &thread : threads_ )
+	{
+		if ( thread.joinable() )
+			thread.join();
+	}
+}
+
+void CTS256Pool::setCache( size_t entries, uint32_t verify )
+{
+	std::lock_guard<std::mutex> lock( mutex_ );
+	cacheEntries_ = entries;
+	cacheVerify_ = verify;
+}
+
+void CTS256Pool::setNative( bool native, uint32_t verify )
+{
+	std::lock_guard<std::mutex> lock( mutex_ );
+	native_ = native;
+	nativeVerify_ = verify;
+}
+
+void CTS256Pool::setHLE( uint32_t routines )
+{
+	std::lock_guard<std::mutex> lock( mutex_ );
+	hle_ = routines;
+}
+
+void CTS256Pool::translate( std::string &&text )
+{
+	std::unique_lock<std::mutex> lock( mutex_ );
+
+	output( lock );
+
+	while ( requests_.size() >= window_ )
+	{
+		done_.wait( lock );
+		output( lock );
+	}
+
+	requests_.push_back( { std::move( text ), {}, false, false } );
+	lock.unlock();
+	queued_.notify_one();
+}
+
+void CTS256Pool::finish()
+{
+	std::unique_lock<std::mutex> lock( mutex_ );
+
+	output( lock );
+
+	while ( !requests_.empty() )
+	{
+		done_.wait( lock );
+		output( lock );
+	}
+}
+
+// Pass the results done at the head of the queue to the handler, unlocked;
+// the workers only hold references to the requests after next_
+void CTS256Pool::output( std::unique_lock<std::mutex> &lock )
+{
+	while ( !requests_.empty() && requests_.front().done )
+	{
+		request_t request = std::move( requests_.front() );
+		requests_.pop_front();
+		--next_;
+
+		lock.unlock();
+		handler_( object_, request.allophones, request.ok );
+		lock.lock();
+	}
+}
+
+// Worker thread: own CTS256 instance, converting the next queued request
+void CTS256Pool::worker()
+{
+	std::vector<uint8_t> rom( exceptionRom_ );
+	CTS256 cts256( std::move( rom ), romAddress_ );
+	size_t cacheEntries = 0;
+	uint32_t cacheVerify = 0;
+	bool native = false;
+	uint32_t nativeVerify = 0;
+	uint32_t hle = CTS256::ROUTINES_ALL;
+
+	std::unique_lock<std::mutex> lock( mutex_ );
+
+	while ( true )
+	{
+		while ( !stop_ && next_ >= requests_.size() )
+			queued_.wait( lock );
+
+		if ( next_ >= requests_.size() )
+			break;
+
+		request_t &request = requests_[next_++];
+
+		if ( cacheEntries != cacheEntries_ || cacheVerify != cacheVerify_ )
+		{
+			cacheEntries = cacheEntries_;
+			cacheVerify = cacheVerify_;
+			cts256.setCache( cacheEntries, cacheVerify );
+		}
+
+		if ( native != native_ || nativeVerify != nativeVerify_ )
+		{
+			native = native_;
+			nativeVerify = nativeVerify_;
+			cts256.setNative( native, nativeVerify );
+		}
+
+		if ( hle != hle_ )
+		{
+			hle = hle_;
+			cts256.setHLE( hle );
+		}
+
+		lock.unlock();
+		request.ok = cts256.translate( request.text, request.allophones );
+		lock.lock();
+
+		request.done = true;
+		done_.notify_one();
+	}
+
+	instructions_ += cts256.getInstructions();
+	cycles_ += cts256.getCycles();
+	utterances_ += cts256.getUtterances();
+
+	CTS256::cacheStats_t stats = cts256.getCacheStats();
+	cacheStats_.hits += stats.hits;
+	cacheStats_.misses += stats.misses;
+	cacheStats_.evictions += stats.evictions;
+	cacheStats_.bypassed += stats.bypassed;
+	cacheStats_.verified += stats.verified;
+	cacheStats_.mismatches += stats.mismatches;
+
+	CTS256::nativeStats_t nativeStats = cts256.getNativeStats();
+	nativeStats_.converted += nativeStats.converted;
+	nativeStats_.bypassed += nativeStats.bypassed;
+	nativeStats_.verified += nativeStats.verified;
+	nativeStats_.mismatches += nativeStats.mismatches;
+
+	CTS256::hleStats_t hleStats = cts256.getHLEStats();
+	hleStats_.calls += hleStats.calls;
+	hleStats_.checks += hleStats.checks;
+	hleStats_.mismatches += hleStats.mismatches;
+}
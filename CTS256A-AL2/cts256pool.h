@@ -0,0 +1,159 @@
+/*
+    CTS256A-AL2 - Text-To-Allophones Instance Pool.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "cts256.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Parallel conversion of independent requests by a pool of CTS256 instances,
+// one per worker thread. The results are passed to the handler in the order
+// of the requests, by the thread calling translate() and finish().
+class CTS256Pool
+{
+public:
+	// Result handler: allophone codes of a request, and false if the ROM
+	// stalled before the end of its conversion
+	typedef void (*result_t)( void *object, const std::vector<uint8_t> &allophones, bool ok );
+
+	// With threads workers (0: one per hardware thread)
+	CTS256Pool( uint32_t threads, result_t handler, void *object );
+
+	// With the exception ROM image located at romAddress (1000..E000)
+	CTS256Pool( uint32_t threads, result_t handler, void *object,
+		const std::vector<uint8_t> &exceptionRom, uint16_t romAddress );
+
+	// Finish the pending requests and stop the workers
+	~CTS256Pool();
+
+	// Queue a request, and pass the results done so far to the handler;
+	// waits while too many requests are pending
+	void translate( std::string &&text );
+
+	// Wait for all the requests, and pass their results to the handler
+	void finish();
+
+	// Get the number of worker threads
+	uint32_t getThreads() const
+	{
+		return uint32_t( threads_.size() );
+	}
+
+	// Get the number of emulated instructions, cycles and utterances of all
+	// the conversions, after stop()
+	uint64_t getInstructions() const
+	{
+		return instructions_;
+	}
+
+	uint64_t getCycles() const
+	{
+		return cycles_;
+	}
+
+	uint64_t getUtterances() const
+	{
+		return utterances_;
+	}
+
+	// Cache the words converted by each worker (see CTS256::setCache)
+	void setCache( size_t entries, uint32_t verify = 0 );
+
+	// Get the word cache statistics of all the workers, after stop()
+	const CTS256::cacheStats_t &getCacheStats() const
+	{
+		return cacheStats_;
+	}
+
+	// Convert with the native rule engine of each worker (see
+	// CTS256::setNative)
+	void setNative( bool native, uint32_t verify = 0 );
+
+	// Get the native engine statistics of all the workers, after stop()
+	const CTS256::nativeStats_t &getNativeStats() const
+	{
+		return nativeStats_;
+	}
+
+	// Run the ROM subroutines natively in each worker (see CTS256::setHLE)
+	void setHLE( uint32_t routines );
+
+	// Get the native routines statistics of all the workers, after stop()
+	const CTS256::hleStats_t &getHLEStats() const
+	{
+		return hleStats_;
+	}
+
+	// Stop the workers, once the queued requests are converted; done by
+	// the destructor
+	void stop();
+
+private:
+	struct request_t
+	{
+		std::string				text;
+		std::vector<uint8_t>	allophones;
+		bool					ok;
+		bool					done;
+	};
+
+	void start( uint32_t threads );
+
+	void worker();
+
+	// Pass the results done at the head of the queue to the handler
+	void output( std::unique_lock<std::mutex> &lock );
+
+	result_t					handler_;
+	void						*object_;
+	std::vector<uint8_t>		exceptionRom_;
+	uint16_t					romAddress_;
+	std::vector<std::thread>	threads_;
+	std::mutex					mutex_;
+	std::condition_variable		queued_;		///< request queued, or stop
+	std::condition_variable		done_;			///< request done
+	std::deque<request_t>		requests_;		///< requests not output yet
+	size_t						next_;			///< next request to convert
+	size_t						window_;		///< max pending requests
+	bool						stop_;
+	uint64_t					instructions_;
+	uint64_t					cycles_;
+	uint64_t					utterances_;
+	size_t						cacheEntries_;
+	uint32_t					cacheVerify_;
+	CTS256::cacheStats_t		cacheStats_;
+	bool						native_;
+	uint32_t					nativeVerify_;
+	CTS256::nativeStats_t		nativeStats_;
+	uint32_t					hle_;
+	CTS256::hleStats_t			hleStats_;
+};
@@ -0,0 +1,858 @@
+/*
+    CTS256A-AL2 - Native Rule Engine.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "cts256rules.h"
+#include "CTS256A_AL2_ROM.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include <ctype.h>
+
+// Size of the ROM input ring (R40:R41..R42:R43, 3000..36FF)
+#define RING_SIZE			0x700
+
+// Start of the text in the ring, after the " O-K" and CR of the ROM init
+#define RING_TEXT			5
+
+// Max number of characters converted, so that the whole text is stored
+// before converted, as in the emulator with the flow control
+#define RULES_MAX_TEXT		1024
+
+// Max number of rules of an exception table
+#define RULES_MAX_EXCEPTIONS	0x1000
+
+// Candidate keys: bracket character codes 00..3F, and others
+#define RULES_KEYS			0x41
+
+// Max number of exception candidates by first character, before looking
+// up the whole bracket: the brackets are compared faster up to there
+#define RULES_MAX_CANDIDATES	8
+
+// Exception ROM: signature, jumps to the init and word routines,
+// parameters, table pointers (A..Z, others) and standard routines, as
+// built by cts_eprom
+#define EXCEPTION_JUMPS		0x005
+#define EXCEPTION_PARAMS	0x009
+#define EXCEPTION_INIT		0x023
+#define EXCEPTION_TABLES	0x0A3
+#define EXCEPTION_WORD		0x0D9
+
+static const uint8_t exceptionJumps[] = { 0xE0, 0x35, 0xE0, 0x31 };
+
+static const uint8_t exceptionInit[] =
+{
+	0x1E,0x1F,0x20,0x21,0x28,0x29,0x24,0x25,0x22,0x23,0x2A,0x2B,0x26,0x27,0x2C,0x2D,
+	0x2E,0x2F,0x32,0x33,0x34,0x35,0x36,0xE0,0x65,0x78,0x02,0x31,0x8E,0xF1,0x43,0xC5,
+	0xAA,0x00,0x09,0x2D,0xFF,0xE2,0x1E,0xB8,0xAA,0x00,0x23,0xD5,0x12,0xD0,0x13,0xB9,
+	0x9B,0x13,0xC3,0xAA,0x00,0x09,0x2D,0xFF,0xE2,0x0B,0xB8,0xAA,0x00,0x23,0xD5,0x12,
+	0xD0,0x13,0xB9,0x9B,0x13,0x5D,0x16,0xE6,0xE9,0xC3,0xAA,0x00,0x09,0x2D,0xFF,0xE2,
+	0x14,0xA2,0x40,0x11,0x82,0x11,0xA2,0x15,0x11,0xC3,0xAA,0x00,0x09,0x82,0x15,0xC3,
+	0xAA,0x00,0x09,0x82,0x14,0x98,0x29,0x03,0x98,0x2B,0x07,0x22,0x20,0x9B,0x03,0x8E,
+	0xF7,0x2B,0x9B,0x03,0x05,0x98,0x07,0x09,0x98,0x03,0x19,0x8C,0xF1,0x00,0xE0,0x36,
+};
+
+static const uint16_t exceptionInitFixups[] = { 0x044, 0x04C, 0x057, 0x05F, 0x06E, 0x07E, 0x084 };
+
+static const uint8_t exceptionWord[] =
+{
+	0xD8,0x02,0xD8,0x03,0x98,0x03,0x11,0x8E,0xF7,0x4B,0x8E,0xF7,0x0F,0x77,0x01,0x0A,
+	0x05,0x74,0x80,0x0B,0xE0,0x03,0x73,0x7F,0x0B,0x8E,0xF3,0xAF,0x76,0x20,0x0A,0x0E,
+	0x52,0x34,0xAA,0x50,0xA3,0xD0,0x14,0xAA,0x50,0xA4,0xD0,0x15,0xE0,0x0F,0xC5,0x2A,
+	0x41,0x2C,0x02,0xAA,0x50,0xA3,0xD0,0x14,0xAA,0x50,0xA4,0xD0,0x15,0x52,0x01,0x8E,
+	0xF4,0x88,0x8E,0xF4,0xC2,0x76,0x10,0x0A,0x4D,0x2D,0xFF,0xE2,0x60,0x98,0x11,0x1D,
+	0x73,0xBF,0x0A,0x8E,0xF5,0x64,0x76,0x10,0x0A,0x3C,0x8E,0xF4,0x7E,0x74,0x40,0x0A,
+	0x8E,0xF5,0x64,0x76,0x10,0x0A,0x42,0x48,0x37,0x34,0x79,0x00,0x33,0xD5,0x37,0x73,
+	0xFD,0x0B,0x52,0x02,0x8E,0xF4,0x88,0x8E,0xF4,0x9E,0x98,0x0F,0x03,0x98,0x03,0x11,
+	0x8E,0xF7,0x4B,0x77,0x80,0x0B,0x0A,0xDB,0x39,0x8E,0xF3,0x47,0xC9,0xC9,0x8C,0xF1,
+	0x36,0xC9,0xC9,0x8C,0xF3,0xF4,0xD3,0x15,0xE7,0x02,0xD3,0x14,0x52,0x02,0x8E,0xF4,
+	0x88,0x72,0x01,0x37,0x73,0xFD,0x0B,0xE0,0x99,0x52,0x03,0xE0,0xF1,0xD9,0x03,0xD9,
+	0x02,0xD5,0x37,0x73,0xFD,0x0B,0x8C,0xF3,0xEE,0xFF,
+};
+
+static const uint16_t exceptionWordFixups[] = { 0x0FC, 0x101, 0x10D, 0x112 };
+
+// Code of a character as compared by the rules (F4DD)
+static inline uint8_t toCode( uint8_t c )
+{
+	return uint8_t( c >= 0x61 ? c - 0x40 : c - 0x20 );
+}
+
+// Check if the ROM sees c as a letter (F3AF)
+static inline bool isLetter( uint8_t c )
+{
+	return ( c >= 'A' && c <= 'Z' ) || ( c >= 'a' && c <= 'z' );
+}
+
+// Check if the rule context byte is supported: a literal or a symbol
+static bool isContextByte( uint8_t c )
+{
+	return c == SYMBOL_QUOTE || !( uint8_t( c - SYMBOL_LITERALS ) & 0x80 )
+		|| ( c >= SYMBOL_VOWELS && c <= SYMBOL_VOWELS2 );
+}
+
+// Check if the routine is in the exception ROM image, with the fixups of
+// its address
+static bool hasRoutine( const std::vector<uint8_t> &rom, uint16_t romAddress, uint16_t addr,
+	const uint8_t *code, size_t size, const uint16_t *fixups, size_t fixupCount )
+{
+	if ( rom.size() < addr + size )
+		return false;
+
+	for ( size_t i = 0; i < size; ++i )
+	{
+		uint8_t c = code[i];
+
+		for ( size_t j = 0; j < fixupCount; ++j )
+		{
+			if ( fixups[j] == addr + i )
+				c = uint8_t( romAddress >> 8 );
+		}
+
+		if ( rom[addr + i] != c )
+			return false;
+	}
+
+	return true;
+}
+
+CTS256Rules::CTS256Rules()
+: CTS256Rules( std::vector<uint8_t>(), 0 )
+{
+}
+
+CTS256Rules::CTS256Rules( const std::vector<uint8_t> &exceptionRom, uint16_t romAddress )
+: supported_( true )
+, exceptionRom_( exceptionRom )
+, romAddress_( romAddress )
+, hashShift_( 32 )
+, tables_()
+, exceptions_()
+, hasExceptions_( false )
+, classes_()
+, ring_()
+, r3_( RING_TEXT )
+, r15_( RING_TEXT )
+, r17_( RING_TEXT )
+, r19_( RING_TEXT )
+, r29_( RING_TEXT )
+, letter_( false )
+, left_( false )
+{
+	// Input ring after the ROM init: " O-K" and CR, and the RAM test
+	// pattern left at the page starts
+	static const uint8_t init[] = { 0x20, 0x4F, 0xAD, 0x4B, 0x8D };
+
+	std::copy( std::begin( init ), std::end( init ), ring_.begin() );
+	for ( uint32_t page = 0x200; page < RING_SIZE; page += 0x100 )
+		ring_[page] = 0xA5;
+
+	// Characters as stored by the input routine; the editing characters and
+	// the lines are converted depending on the timing: not supported
+	for ( uint32_t i = 0; i < input_.size(); ++i )
+	{
+		uint8_t c = uint8_t( toupper( i ) );
+		bool editing = c == 0x0D || c == 0x1B || c == 0x12 || c == 0x08;
+
+		input_[i] = editing ? 0 : CTS256A_AL2_isDelimiter( c ) ? c | 0x80 : c;
+	}
+
+	extract( exceptionRom, romAddress );
+}
+
+uint8_t CTS256Rules::readMemory( uint16_t addr ) const
+{
+	if ( addr >= 0xF000 )
+		return CTS256A_AL2_readRom( addr );
+
+	if ( !exceptionRom_.empty() && addr >= romAddress_ && size_t( addr - romAddress_ ) < exceptionRom_.size() )
+		return exceptionRom_[addr & 0x0FFF];
+
+	return RULE_EMPTY;
+}
+
+void CTS256Rules::extract( const std::vector<uint8_t> &exceptionRom, uint16_t romAddress )
+{
+	for ( uint16_t i = 0; i < sizeof( classes_ ); ++i )
+		classes_[i] = CTS256A_AL2_readRom( CLASSES + i );
+
+	// Main rules: one sequence, from the punctuation to the last letter
+	uint32_t first = extractRules( RULES_PUNCTUATION, RULES_LETTERS, false );
+	uint32_t end = uint32_t( rules_.size() );
+
+	for ( uint32_t i = 0; i < 28; ++i )
+	{
+		table_t &table = tables_[i];
+		uint16_t addr = i < 26
+			? uint16_t( ( readMemory( RULES_LETTERS + 2 * i ) << 8 ) | readMemory( RULES_LETTERS + 2 * i + 1 ) )
+			: i == 26 ? RULES_DIGITS : RULES_PUNCTUATION;
+
+		// Opening bracket of the first rule (F488)
+		while ( !( readMemory( addr ) & RULE_OPEN ) )
+			++addr;
+
+		table.first = end;
+		for ( uint32_t j = first; j < end; ++j )
+		{
+			if ( rules_[j].addr == addr )
+				table.first = j;
+		}
+
+		if ( table.first == end )
+			supported_ = false;
+
+		table.end = end;
+		table.letters = i < 26;
+		indexTable( table );
+	}
+
+	// Exception rules: with the standard routines only, the ROM is
+	// visible from 5000 to EFFF
+	if ( exceptionRom.size() < 5 || !std::equal( exceptionRom.begin(), exceptionRom.begin() + 5, classes_ ) )
+		return;
+
+	bool standard = romAddress >= 0x5000 && romAddress < 0xF000 && !( romAddress & 0x0FFF )
+		&& hasRoutine( exceptionRom, romAddress, EXCEPTION_JUMPS, exceptionJumps, sizeof( exceptionJumps ), nullptr, 0 )
+		&& hasRoutine( exceptionRom, romAddress, EXCEPTION_INIT, exceptionInit, sizeof( exceptionInit ),
+			exceptionInitFixups, sizeof( exceptionInitFixups ) / sizeof( *exceptionInitFixups ) )
+		&& hasRoutine( exceptionRom, romAddress, EXCEPTION_WORD, exceptionWord, sizeof( exceptionWord ),
+			exceptionWordFixups, sizeof( exceptionWordFixups ) / sizeof( *exceptionWordFixups ) );
+
+	// Default parameters only
+	for ( uint16_t i = EXCEPTION_PARAMS; standard && i < EXCEPTION_INIT; ++i )
+		standard = exceptionRom[i] == RULE_EMPTY;
+
+	if ( !standard )
+	{
+		supported_ = false;
+		return;
+	}
+
+	// Bracket prefixes: none, then the table roots
+	links_t links;
+
+	prefixes_.resize( 28 );
+	for ( uint32_t i = 0; i < 27; ++i )
+	{
+		table_t &table = exceptions_[i];
+		uint16_t ptr = uint16_t( romAddress + EXCEPTION_TABLES + 2 * i );
+		uint16_t addr = uint16_t( ( readMemory( ptr ) << 8 ) | readMemory( ptr + 1 ) );
+
+		while ( !( readMemory( addr ) & RULE_OPEN ) )
+			++addr;
+
+		table.first = extractRules( addr, 0x10000, true );
+		table.end = uint32_t( rules_.size() );
+		table.letters = i < 26;
+
+		if ( !rules_[table.end - 1].end )
+			supported_ = false;
+
+		indexTable( table );
+		indexBrackets( i, links );
+	}
+
+	hashLinks( links );
+
+	hasExceptions_ = true;
+}
+
+uint32_t CTS256Rules::extractRules( uint16_t addr, uint32_t end, bool exceptions )
+{
+	uint32_t first = uint32_t( rules_.size() );
+	uint32_t a = addr;
+
+	while ( a < end )
+	{
+		rule_t rule;
+		uint32_t p;
+		uint8_t c;
+		size_t size = bytes_.size();
+
+		rule.addr = uint16_t( a );
+		rule.empty = readMemory( rule.addr ) == RULE_EMPTY;
+		rule.end = exceptions && rule.empty;
+		rule.bytes = uint32_t( size );
+
+		// Bracket (F4DD): up to the closing character
+		p = a;
+		if ( rule.empty )
+			++p;
+		else
+		{
+			do
+			{
+				c = readMemory( uint16_t( p++ ) );
+				bytes_.push_back( c );
+			}
+			while ( !( c & RULE_CLOSE ) && p < 0x10000 );
+		}
+		rule.bracketSize = uint8_t( bytes_.size() - size );
+		size = bytes_.size();
+
+		// Right context (F564): up to the allophones
+		for ( ; p < 0x10000 && !( ( c = readMemory( uint16_t( p ) ) ) & RULE_OPEN ); ++p )
+		{
+			supported_ &= isContextByte( c );
+			bytes_.push_back( c );
+		}
+		rule.rightSize = uint8_t( bytes_.size() - size );
+		size = bytes_.size();
+
+		uint32_t allophones = p;
+
+		// Left context (F564 with R10 bit 6): from the bracket outwards
+		for ( p = a - 1; !( ( c = readMemory( uint16_t( p ) ) ) & RULE_CLOSE ); --p )
+		{
+			supported_ &= isContextByte( c );
+			bytes_.push_back( c );
+		}
+		rule.leftSize = uint8_t( bytes_.size() - size );
+		size = bytes_.size();
+
+		// Allophones (F49E): up to the last one or to an empty rule
+		for ( p = allophones; p < 0x10000 && ( c = readMemory( uint16_t( p ) ) ) != RULE_EMPTY; ++p )
+		{
+			bytes_.push_back( c & 0x3F );
+			if ( c & RULE_CLOSE )
+				break;
+		}
+		rule.allophoneCount = uint8_t( bytes_.size() - size );
+
+		if ( bytes_.size() - rule.bytes > 0xFF )
+			supported_ = false;
+
+		rules_.push_back( rule );
+
+		if ( rule.end || rules_.size() - first > RULES_MAX_EXCEPTIONS )
+			break;
+
+		// Next rule (F47A): the opening bracket after the allophones
+		for ( a = allophones + 1; a < end && !( readMemory( uint16_t( a ) ) & RULE_OPEN ); ++a )
+			;
+	}
+
+	return first;
+}
+
+void CTS256Rules::indexTable( table_t &table )
+{
+	for ( uint32_t key = 0; key < RULES_KEYS; ++key )
+	{
+		table.index[key] = uint32_t( index_.size() );
+
+		for ( uint32_t i = table.first; i < table.end; ++i )
+		{
+			const rule_t &rule = rules_[i];
+
+			if ( rule.empty || ( key < 0x40 && ( bytes_[rule.bytes] & 0x3F ) == key ) )
+				index_.push_back( i );
+
+			// No rule reached after an unconditional one
+			if ( rule.end || ( rule.empty && !rule.rightSize && !rule.leftSize ) )
+				break;
+		}
+	}
+
+	table.index[RULES_KEYS] = uint32_t( index_.size() );
+}
+
+void CTS256Rules::indexBrackets( uint32_t i, links_t &links )
+{
+	const table_t &table = exceptions_[i];
+	std::unordered_map<uint32_t, std::vector<uint32_t>> rules;
+
+	for ( uint32_t j = table.first; j < table.end; ++j )
+	{
+		const rule_t &rule = rules_[j];
+
+		if ( !rule.empty )
+		{
+			uint32_t prefix = i + 1;
+
+			for ( uint8_t k = 0; k < rule.bracketSize; ++k )
+			{
+				uint32_t &next = links[prefix << 6 | ( bytes_[rule.bytes + k] & 0x3F )];
+
+				if ( !next )
+				{
+					next = uint32_t( prefixes_.size() );
+					prefixes_.emplace_back();
+				}
+				prefix = next;
+			}
+
+			rules[prefix].push_back( j );
+		}
+
+		// No rule reached after an unconditional one
+		if ( rule.end || ( rule.empty && !rule.rightSize && !rule.leftSize ) )
+			break;
+	}
+
+	for ( const auto &bracket : rules )
+	{
+		prefix_t &prefix = prefixes_[bracket.first];
+
+		prefix.first = uint32_t( exceptionRules_.size() );
+		prefix.count = uint32_t( bracket.second.size() );
+		exceptionRules_.insert( exceptionRules_.end(), bracket.second.begin(), bracket.second.end() );
+	}
+}
+
+void CTS256Rules::hashLinks( const links_t &links )
+{
+	// Open addressing, half full at most
+	uint32_t bits = 1;
+
+	while ( ( 1u << bits ) < 2 * links.size() )
+		++bits;
+
+	links_.assign( size_t( 1 ) << bits, 0 );
+	hashShift_ = 32 - bits;
+
+	for ( const auto &link : links )
+	{
+		uint32_t mask = uint32_t( links_.size() ) - 1;
+		uint32_t slot = ( link.first * 0x9E3779B1u ) >> hashShift_;
+
+		while ( links_[slot] )
+			slot = ( slot + 1 ) & mask;
+
+		links_[slot] = uint64_t( link.first ) << 32 | link.second;
+	}
+}
+
+void CTS256Rules::findExceptions( const table_t &table )
+{
+	// Rules without bracket, up to the end of the table (key 40)
+	candidates_.assign( index_.data() + table.index[0x40], index_.data() + table.index[0x41] );
+
+	// Rules with the bracket of each start of the word, from the initial
+	// for the punctuation and digits, after it for the letters, up to the
+	// first start that no bracket begins with
+	uint32_t p = letter_ ? r3_ : previous( r3_ );
+	uint32_t prefix = uint32_t( &table - exceptions_ ) + 1;
+	uint8_t code;
+
+	while ( ( code = toCode( ring_[p] & 0x7F ) ) < 0x40 && ( prefix = findPrefix( prefix, code ) ) )
+	{
+		const uint32_t *rule = exceptionRules_.data() + prefixes_[prefix].first;
+
+		candidates_.insert( candidates_.end(), rule, rule + prefixes_[prefix].count );
+		p = next( p );
+	}
+
+	// In table order
+	std::sort( candidates_.begin(), candidates_.end() );
+}
+
+bool CTS256Rules::translate( std::string_view text, std::vector<uint8_t> &allophones )
+{
+	if ( !supported_ || text.size() > RULES_MAX_TEXT )
+		return false;
+
+	// Nothing read: no CR stored, nothing converted
+	if ( text.empty() )
+		return true;
+
+	// Store the text as the input routine (F1E2), and the CR at the end
+	uint32_t end = RING_TEXT;
+	bool ok = true;
+
+	for ( char ch : text )
+	{
+		uint8_t c = input_[uint8_t( ch )];
+
+		if ( !c )
+		{
+			ok = false;
+			break;
+		}
+
+		ring_[end++] = c;
+	}
+	ring_[end++] = 0x8D;
+
+	// Convert the words (F110)
+	size_t size = allophones.size();
+
+	r3_ = RING_TEXT;
+	while ( ok && r3_ != end )
+		ok = convertWord( allophones ) && r3_ - RING_TEXT <= end - RING_TEXT;
+
+	if ( !ok )
+		allophones.resize( size );
+
+	// Restore the ring for the next text
+	for ( uint32_t i = RING_TEXT; i < end; ++i )
+		ring_[i] = ( i & 0xFF ) || i < 0x200 ? 0 : 0xA5;
+
+	return ok;
+}
+
+bool CTS256Rules::convertWord( std::vector<uint8_t> &allophones )
+{
+	bool last = false;
+	bool exception = false;
+
+	// Exception rules of the word initial (exception word routine); at the
+	// end of the table, the word is converted from its start
+	if ( hasExceptions_ )
+	{
+		uint32_t start = r3_;
+
+		r17_ = previous( r3_ );
+		switch ( convert( true, last, allophones ) )
+		{
+		case MATCH_NONE:
+			return false;
+		case MATCH_RULE:
+			if ( last )
+				return true;
+			exception = true;
+			break;
+		case MATCH_END:
+			r3_ = start;
+			break;
+		}
+	}
+
+	if ( !exception )
+		r17_ = previous( r3_ );
+
+	do
+	{
+		if ( convert( false, last, allophones ) != MATCH_RULE )
+			return false;
+	}
+	while ( !last );
+
+	return true;
+}
+
+CTS256Rules::match_t CTS256Rules::convert( bool exceptions, bool &last, std::vector<uint8_t> &allophones )
+{
+	uint8_t c = ring_[r3_];
+
+	r3_ = next( r3_ );
+	last = ( c & 0x80 ) != 0;
+	c &= 0x7F;
+
+	// Rule table of the character (F3AF)
+	const table_t *table;
+
+	letter_ = isLetter( c );
+	if ( letter_ )
+		table = &( exceptions ? exceptions_ : tables_ )[( c & 0xDF ) - 'A'];
+	else if ( exceptions )
+		table = &exceptions_[26];
+	else
+		table = &tables_[c >= '0' && c <= '9' ? 26 : 27];
+
+	// Candidate rules by the first character of the bracket, or by the
+	// whole bracket for the exceptions sharing a first character; all the
+	// rules in sequence if a suffix (%) changed the letter flag
+	uint8_t code = toCode( letter_ ? ring_[r3_] & 0x7F : c );
+	uint32_t key = code < 0x40 ? code : 0x40;
+	const uint32_t *candidate = &index_[0] + table->index[key];
+	const uint32_t *candidateEnd = &index_[0] + table->index[key + 1];
+
+	if ( exceptions && candidateEnd - candidate > RULES_MAX_CANDIDATES )
+	{
+		findExceptions( *table );
+		candidate = candidates_.data();
+		candidateEnd = candidate + candidates_.size();
+	}
+
+	bool indexed = true;
+	uint32_t i = table->first;
+
+	while ( true )
+	{
+		if ( indexed )
+		{
+			if ( candidate == candidateEnd )
+				return MATCH_NONE;
+			i = *candidate++;
+		}
+		else if ( ++i >= table->end )
+			return MATCH_NONE;
+
+		const rule_t &rule = rules_[i];
+
+		if ( matchBracket( rule ) )
+		{
+			if ( rule.end )
+				return MATCH_END;
+
+			const uint8_t *bytes = &bytes_[rule.bytes + rule.bracketSize];
+
+			r29_ = r17_;
+			left_ = false;
+			if ( matchContext( bytes, rule.rightSize ) )
+			{
+				left_ = true;
+				if ( matchContext( bytes + rule.rightSize, rule.leftSize ) )
+				{
+					bytes += rule.rightSize + rule.leftSize;
+					allophones.insert( allophones.end(), bytes, bytes + rule.allophoneCount );
+					r3_ = r15_;
+					r17_ = previous( r3_ );
+					return MATCH_RULE;
+				}
+			}
+		}
+
+		if ( letter_ != table->letters )
+			indexed = false;
+	}
+}
+
+bool CTS256Rules::matchBracket( const rule_t &rule )
+{
+	r19_ = r3_;
+
+	if ( !rule.empty )
+	{
+		// The initial is in the bracket of the punctuation and digits
+		if ( !letter_ )
+			r3_ = previous( r3_ );
+
+		const uint8_t *bracket = &bytes_[rule.bytes];
+
+		for ( uint8_t i = 0; i < rule.bracketSize; ++i )
+		{
+			if ( ( bracket[i] & 0x3F ) != toCode( read() ) )
+			{
+				r3_ = r19_;
+				return false;
+			}
+		}
+	}
+
+	r15_ = r3_;
+	return true;
+}
+
+uint8_t CTS256Rules::fetch()
+{
+	uint8_t c;
+
+	if ( left_ )
+	{
+		c = ring_[r17_] & 0x7F;
+		r17_ = previous( r17_ );
+	}
+	else
+	{
+		c = read();
+	}
+
+	return toCode( c );
+}
+
+void CTS256Rules::unfetch()
+{
+	if ( left_ )
+		r17_ = next( r17_ );
+	else
+		r3_ = previous( r3_ );
+}
+
+bool CTS256Rules::matchContext( const uint8_t *symbols, uint8_t size )
+{
+	for ( uint8_t i = 0; i < size; ++i )
+	{
+		uint8_t symbol = symbols[i];
+		uint8_t code = fetch();
+		bool match = true;
+
+		if ( symbol == SYMBOL_QUOTE || !( uint8_t( symbol - SYMBOL_LITERALS ) & 0x80 ) )
+		{
+			match = symbol == code;
+		}
+		else
+		{
+			switch ( symbol )
+			{
+			case SYMBOL_VOWELS:
+				match = ( getClass( code ) & 0x80 ) != 0;
+				if ( match )
+				{
+					while ( getClass( fetch() ) & 0x80 )
+						;
+					unfetch();
+				}
+				break;
+			case SYMBOL_VOICED:
+				match = ( getClass( code ) & 0x40 ) != 0;
+				break;
+			case SYMBOL_SUFFIX:
+				match = matchSuffix( code );
+				break;
+			case SYMBOL_SIBILANT:
+				// S, C, G, Z, X, J, CH or SH
+				if ( !( getClass( code ) & 0x20 ) )
+				{
+					code = fetch();
+					match = ( code == 0x23 || code == 0x33 ) && matchH();
+				}
+				break;
+			case SYMBOL_LONG_U:
+				// T, S, R, D, L, Z, N, J, TH, CH or SH
+				if ( !( getClass( code ) & 0x10 ) )
+				{
+					code = fetch();
+					match = ( code == 0x34 || code == 0x23 || code == 0x33 ) && matchH();
+				}
+				break;
+			case SYMBOL_CONSONANT:
+				match = ( getClass( code ) & 0x08 ) != 0;
+				break;
+			case SYMBOL_FRONT:
+				match = ( getClass( code ) & 0x04 ) != 0;
+				break;
+			case SYMBOL_CONSONANTS0:
+				if ( getClass( code ) & 0x08 )
+				{
+					while ( getClass( fetch() ) & 0x08 )
+						;
+				}
+				unfetch();
+				break;
+			case SYMBOL_CONSONANTS1:
+				match = ( getClass( code ) & 0x08 ) != 0;
+				if ( match )
+				{
+					while ( getClass( fetch() ) & 0x08 )
+						;
+					unfetch();
+				}
+				break;
+			case SYMBOL_BACK:
+				match = ( getClass( code ) & 0x02 ) != 0;
+				break;
+			case SYMBOL_NONLETTER:
+				match = getClass( code ) == 0;
+				break;
+			case SYMBOL_VOWELS2:
+				match = ( getClass( code ) & 0x80 ) && ( getClass( fetch() ) & 0x80 );
+				if ( match )
+				{
+					while ( getClass( fetch() ) & 0x80 )
+						;
+					unfetch();
+				}
+				break;
+			default:
+				match = false;
+				break;
+			}
+		}
+
+		// Restore the pointers (F59A)
+		if ( !match )
+		{
+			r3_ = r19_;
+			r17_ = r29_;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool CTS256Rules::matchH()
+{
+	// The character after the C or S, read from the left context pointer
+	// in both directions (F6FC)
+	r3_ = next( next( r17_ ) );
+	return read() == 'H';
+}
+
+bool CTS256Rules::matchSuffix( uint8_t code )
+{
+	// The suffix characters are read forwards in both directions (F601)
+	const char *suffix;
+
+	if ( getClass( code ) & 0x01 )
+	{
+		// -E, -ER, -ERS, -ES, -ED, -ELY
+		uint8_t c = read();
+
+		if ( c == 'R' )
+		{
+			if ( read() != 'S' )
+				r3_ = previous( r3_ );
+		}
+		else if ( c == 'L' )
+		{
+			if ( read() != 'Y' )
+				return false;
+		}
+		else if ( c != 'S' && c != 'D' )
+		{
+			r3_ = previous( r3_ );
+		}
+
+		return !isLetterNext();
+	}
+
+	if ( code == 0x29 )
+		suffix = "NG";		// -ING
+	else if ( code == 0x2D )
+		suffix = "ENT";		// -MENT
+	else if ( code == 0x2F )
+		suffix = "R";		// -OR
+	else
+		return false;
+
+	for ( ; *suffix; ++suffix )
+	{
+		if ( read() != uint8_t( *suffix ) )
+			return false;
+	}
+
+	return !isLetterNext();
+}
+
+bool CTS256Rules::isLetterNext()
+{
+	// Sets the letter flag, seen by the brackets of the next rules (F68C)
+	letter_ = isLetter( read() );
+	r3_ = previous( r3_ );
+	return letter_;
+}
+
+uint32_t CTS256Rules::next( uint32_t ptr )
+{
+	return ptr + 1 < RING_SIZE ? ptr + 1 : 0;
+}
+
+uint32_t CTS256Rules::previous( uint32_t ptr )
+{
+	return ptr ? ptr - 1 : RING_SIZE - 1;
+}
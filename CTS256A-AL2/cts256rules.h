@@ -0,0 +1,220 @@
+/*
+    CTS256A-AL2 - Native Rule Engine.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Native letter-to-sound engine: the rules extracted from the tables of the
+// CTS256A-AL2 ROM (and of an exception ROM), matched the way the ROM word
+// routine (F3E7) does, without emulating the TMS7000.
+//
+// The text is stored into a copy of the ROM input ring, as the ROM input
+// routine (F1E2) does, and converted from there: the contexts see the same
+// characters before and after the text as the emulated ROM, and the
+// side effects of the ROM symbol routines are reproduced.
+class CTS256Rules
+{
+public:
+	// With the rules of the CTS256A-AL2 ROM
+	CTS256Rules();
+
+	// With the exception ROM image located at romAddress (1000..E000)
+	CTS256Rules( const std::vector<uint8_t> &exceptionRom, uint16_t romAddress );
+
+	// Check if the rules are supported: false if the exception ROM doesn't
+	// use the standard exception routines, or if a table is malformed
+	bool isSupported() const
+	{
+		return supported_;
+	}
+
+	// Get the number of rules extracted
+	size_t getRules() const
+	{
+		return rules_.size();
+	}
+
+	// Convert the text as CTS256::translate() does, appending the allophone
+	// codes (00..3F). Returns false, without allophones, for the texts not
+	// converted like the ROM: several lines, editing characters, long text
+	bool translate( std::string_view text, std::vector<uint8_t> &allophones );
+
+private:
+	// Rule, as matched by the ROM (F4C2, F564) and output (F49E)
+	struct rule_t
+	{
+		uint16_t	addr;				///< address of the opening bracket
+		bool		empty;				///< no characters in the bracket
+		bool		end;				///< end of an exception table
+		uint8_t		bracketSize;
+		uint8_t		rightSize;
+		uint8_t		leftSize;
+		uint8_t		allophoneCount;
+		uint32_t	bytes;				///< bracket, right, left (from the
+										///< bracket outwards) and allophones
+	};
+
+	// Rule table
+	struct table_t
+	{
+		uint32_t	first;				///< first rule
+		uint32_t	end;				///< after the last rule reachable
+		bool		letters;			///< initial not in the bracket
+		uint32_t	index[66];			///< candidates by bracket character
+										///< code (00..3F, others), and end
+	};
+
+	// Exception bracket prefix: the rules with this bracket
+	struct prefix_t
+	{
+		uint32_t	first;				///< first rule in exceptionRules_
+		uint32_t	count;
+	};
+
+	// Links from the bracket prefixes to the ones a code longer, while
+	// extracting
+	typedef std::unordered_map<uint32_t, uint32_t> links_t;
+
+	// Rule match result
+	enum match_t
+	{
+		MATCH_NONE,						///< no rule (end of the rules)
+		MATCH_RULE,						///< rule matched, allophones output
+		MATCH_END						///< end of exception table
+	};
+
+	void extract( const std::vector<uint8_t> &exceptionRom, uint16_t romAddress );
+
+	// Read the memory as seen by the ROM
+	uint8_t readMemory( uint16_t addr ) const;
+
+	// Extract the rules from the bracket at addr up to the end of an
+	// exception table or to end; returns the index of the first one
+	uint32_t extractRules( uint16_t addr, uint32_t end, bool exceptions );
+
+	// Build the candidate rules of a table, by bracket character
+	void indexTable( table_t &table );
+
+	// Build the bracket prefixes of an exception table (prefix i + 1)
+	void indexBrackets( uint32_t i, links_t &links );
+
+	// Build the hash table of the prefix links
+	void hashLinks( const links_t &links );
+
+	// Get the prefix one code longer, 0 if none
+	uint32_t findPrefix( uint32_t prefix, uint8_t code ) const
+	{
+		uint32_t key = prefix << 6 | code;
+		uint32_t mask = uint32_t( links_.size() ) - 1;
+
+		for ( uint32_t slot = ( key * 0x9E3779B1u ) >> hashShift_; links_[slot]; slot = ( slot + 1 ) & mask )
+		{
+			if ( uint32_t( links_[slot] >> 32 ) == key )
+				return uint32_t( links_[slot] );
+		}
+
+		return 0;
+	}
+
+	// Get the candidate exception rules of the word at the read pointer:
+	// the rules with a bracket equal to a start of the word, and the rules
+	// without bracket, in table order
+	void findExceptions( const table_t &table );
+
+	// Convert the word at the read pointer (F3E7)
+	bool convertWord( std::vector<uint8_t> &allophones );
+
+	// Convert the characters at the read pointer with the first rule
+	// matching (F3F4), or with the exception rules
+	match_t convert( bool exceptions, bool &last, std::vector<uint8_t> &allophones );
+
+	bool matchBracket( const rule_t &rule );
+
+	bool matchContext( const uint8_t *symbols, uint8_t size );
+
+	// Symbol routines reading from the read pointer: H after C or S (F6FC),
+	// suffix (F601), and letter after the suffix (F68C)
+	bool matchH();
+
+	bool matchSuffix( uint8_t code );
+
+	bool isLetterNext();
+
+	// Ring accesses of the ROM (F70F, F75B, F77F)
+	uint8_t read()
+	{
+		uint8_t c = ring_[r3_];
+		r3_ = next( r3_ );
+		return c & 0x7F;
+	}
+
+	uint8_t fetch();
+
+	void unfetch();
+
+	// Letter class of the code of a character (F514)
+	uint8_t getClass( uint8_t code ) const
+	{
+		int8_t letter = int8_t( code );
+		return letter >= 0x21 && letter <= 0x3A ? classes_[letter - 0x21] : 0;
+	}
+
+	static uint32_t next( uint32_t ptr );
+
+	static uint32_t previous( uint32_t ptr );
+
+	bool							supported_;
+	std::vector<uint8_t>			exceptionRom_;
+	uint16_t						romAddress_;
+	std::vector<rule_t>				rules_;
+	std::vector<uint8_t>			bytes_;			///< rule bytes
+	std::vector<uint32_t>			index_;			///< candidate rules
+	std::vector<prefix_t>			prefixes_;		///< exception bracket prefixes
+	std::vector<uint32_t>			exceptionRules_;	///< rules by bracket prefix
+	std::vector<uint64_t>			links_;			///< prefix links: prefix, code, longer prefix
+	uint32_t						hashShift_;		///< hash to links_ index
+	std::vector<uint32_t>			candidates_;	///< exception rules of the word
+	table_t							tables_[28];	///< letters, digits, punctuation
+	table_t							exceptions_[27];	///< letters, others
+	bool							hasExceptions_;
+	uint8_t							classes_[26];
+
+	std::array<uint8_t, 0x100>		input_;			///< character stored, 0: not supported
+
+	// ROM registers, as indexes in the input ring
+	std::array<uint8_t, 0x700>		ring_;			///< input ring (R40:R41..R42:R43)
+	uint32_t						r3_;			///< read pointer
+	uint32_t						r15_;			///< after the bracket matched
+	uint32_t						r17_;			///< left context pointer
+	uint32_t						r19_;			///< read pointer at the rule start
+	uint32_t						r29_;			///< left context pointer at the rule start
+	bool							letter_;		///< R10 bit 5: letter table
+	bool							left_;			///< R10 bit 6: matching the left context
+};
@@ -61,7 +61,7 @@ enum {
 	};
 
 //  Mnemonics for disassembler
-char mnemo[][6] = {
+static const char mnemo[][6] = {
 	"ADC",	"ADD",	"AND",	"ANDP",	"BTJO",	"BTJOP","BTJZ",	"BTJZP",
 	"BR",	"CALL",	"CLR",	"CLRC",	"CMP",	"CMPA",	"DAC",	"DEC",
 	"DECD",	"DINT",	"DJNZ",	"DSB",	"EINT",	"IDLE",	"INC",	"INV",
@@ -92,41 +92,30 @@ enum {		// operand
 	};
 
 
-char			noNewEqu = 0;
-char			labelcolon = 0;
+//  Processor's instruction set, below
+extern instr_t instrTable[];
 
-signed char		offset;
-uint			pc;
 
-int				pcOffset = 0;
-ushort			pcOffsetBeg, pcOffsetEnd;
-char			pcOffsetSeg = 'R';
-
-// Symbols table
-symbol_t		*tms7000Symbols = NULL;
-uint			tms7000SymbolsSize = 0;
-uint			nTms7000Symbols = 0;
-uint			nNewTms7000Symbols = 0;
-
-static char *comment;
-
-
-void setTms7000Symbols( symbol_t *pSymbols, int pNSymbols, int pSymbolsSize )
+Disas7000::Disas7000()
+	: reader_( 0 ), object_( 0 ), noNewEqu_( 0 ), labelcolon_( 0 ), pc_( 0 )
+	, pcOffset_( 0 ), pcOffsetBeg_( 0 ), pcOffsetEnd_( 0 ), pcOffsetSeg_( 'R' )
+	, symbols_( NULL ), symbolsSize_( 0 ), nSymbols_( 0 ), nNewSymbols_( 0 )
+	, comment_( NULL )
 {
-	tms7000Symbols = pSymbols;
-	nTms7000Symbols = pNSymbols;
-	nNewTms7000Symbols = nTms7000Symbols;
-	tms7000SymbolsSize = pSymbolsSize;
-	qsort(tms7000Symbols, nTms7000Symbols, sizeof(symbol_t), (compfptr_t)symSort);
 }
 
-void updateTms7000Symbols()
+void Disas7000::setSymbols( symbol_t *pSymbols, int pNSymbols, int pSymbolsSize )
 {
-	setTms7000Symbols( tms7000Symbols, nNewTms7000Symbols, tms7000SymbolsSize );
+	symbols_ = pSymbols;
+	nSymbols_ = pNSymbols;
+	nNewSymbols_ = nSymbols_;
+	symbolsSize_ = pSymbolsSize;
+	qsort(symbols_, nSymbols_, sizeof(symbol_t), (compfptr_t)symSort);
 }
 
-void resetTms7000Symbols()
+void Disas7000::updateSymbols()
 {
+	setSymbols( symbols_, nNewSymbols_, symbolsSize_ );
 }
 
 // comparison function for qsort() and bsearch()
@@ -146,42 +135,40 @@ int  symCompName(symbol_t *a, symbol_t *b)
     return strcmp (a->name, b->name);
 }
 
-static char getCodeSeg()
+char Disas7000::getCodeSeg()
 {
-	return pcOffset ? pcOffsetSeg : 'C';
+	return pcOffset_ ? pcOffsetSeg_ : 'C';
 }
 
 
 // get label of given code address
-char* getLabel(uint val, char /*ds*/)
+char* Disas7000::getLabel(uint val, char /*ds*/)
 {
-    static char name[40] ;
-
     symbol_t symtofind[1];
     symbol_t *sym;
 
-	comment = NULL;
+	comment_ = NULL;
 
-	name[0] = 0;
+	label_[0] = 0;
 
 	symtofind->val = val;
     symtofind->seg = getCodeSeg();
 
-    sym = (symbol_t*)bsearch(symtofind, tms7000Symbols, nTms7000Symbols, sizeof(symbol_t), (compfptr_t)symSort);
+    sym = (symbol_t*)bsearch(symtofind, symbols_, nSymbols_, sizeof(symbol_t), (compfptr_t)symSort);
     if (sym == NULL)
 	{
-		return name;
+		return label_;
 	}
 
-    strcpy (name, sym->name);
-	if ( labelcolon )
-		strcat (name, ":");
+    strcpy (label_, sym->name);
+	if ( labelcolon_ )
+		strcat (label_, ":");
 
-    return name;
+    return label_;
 }
 
 // set label generated (DS labels)
-void setLabelGen( uint val )
+void Disas7000::setLabelGen( uint val )
 {
     symbol_t symtofind[1];
     symbol_t *sym;
@@ -189,153 +176,142 @@ void setLabelGen( uint val )
 	symtofind->val = val;
     symtofind->seg = getCodeSeg();
 
-    sym = (symbol_t*)bsearch(symtofind, tms7000Symbols, nTms7000Symbols, sizeof(symbol_t), (compfptr_t)symSort);
+    sym = (symbol_t*)bsearch(symtofind, symbols_, nSymbols_, sizeof(symbol_t), (compfptr_t)symSort);
 }
 
 // get label and offset of given code address
-char* getLabelOffset(uint val)
+char* Disas7000::getLabelOffset(uint val)
 {
-    static char name[60] ;
 	unsigned i;
 
     symbol_t symtofind[1];
-    symbol_t *sym;
 
     symtofind->val = val;
     symtofind->seg = getCodeSeg();
 
-    sym = tms7000Symbols;
-
-	for ( i=0; i<nTms7000Symbols; ++i )
+	for ( i=0; i<nSymbols_; ++i )
 	{
-		if ( symSort( symtofind, tms7000Symbols+i ) < 0 )
+		if ( symSort( symtofind, symbols_+i ) < 0 )
 			break;
 	}
 
-    name[0] = 0;
+    labelOffset_[0] = 0;
 
 	if (i>0)
 	{
-		if ( tms7000Symbols[i-1].val && val-tms7000Symbols[i-1].val < 0x0400 )
-			sprintf( name, "%s+%Xh", tms7000Symbols[i-1].name, val-tms7000Symbols[i-1].val );
+		if ( symbols_[i-1].val && val-symbols_[i-1].val < 0x0400 )
+			sprintf( labelOffset_, "%s+%Xh", symbols_[i-1].name, val-symbols_[i-1].val );
     }
 
-    return name;
+    return labelOffset_;
 }
 
-// Data Read Routine (memory address space)
-uchar getData_null(ushort /*addr*/)
+void Disas7000::setMemIO( Memory_I::reader_t reader, void *object )
 {
-	return 0xFF;
+	reader_ = reader;
+	object_ = object;
 }
 
-readfptr_t vgetData = getData_null;
-
-void setTms7000MemIO( readfptr_t getData )
+//  get next instruction byte (sim)
+uchar Disas7000::fetch()
 {
-	vgetData = getData;
+	ushort addr = ushort( pc_++ );
+	return reader_ ? reader_( object_, addr ) : 0xFF;
 }
 
-#define getData (*vgetData)
-
-//  get next instruction byte (sim)
-#define fetch() getData( ushort( pc++ ) )
-
 //  return hex-string or label for double-byte x (dasm)
-char* getXAddr( uint x )
+char* Disas7000::getXAddr( uint x )
 {
-	static char addr[41];
 	symbol_t symtofind;
 	symbol_t *sym;
 
-	comment = NULL;
+	comment_ = NULL;
 
 	symtofind.val = x;
 	symtofind.seg = getCodeSeg();
 
-	sym = (symbol_t*)bsearch(&symtofind, tms7000Symbols, nTms7000Symbols, sizeof(symbol_t), (compfptr_t)symSort);
+	sym = (symbol_t*)bsearch(&symtofind, symbols_, nSymbols_, sizeof(symbol_t), (compfptr_t)symSort);
 
 	if ( sym )
 	{
-		strcpy(addr, sym->name);
+		strcpy(xaddr_, sym->name);
 	}
 	else
 	{
 		uint xorg = x;
-		if ( pcOffsetSeg != 'C' )
-			xorg -= pcOffset;
+		if ( pcOffsetSeg_ != 'C' )
+			xorg -= pcOffset_;
 
-		sprintf( addr, ">%04X", xorg );
+		sprintf( xaddr_, ">%04X", xorg );
 	}
-	return addr;
+	return xaddr_;
 }
 
 // get comment associated to label of given code address from last getXAddr()/getLabel() call
-char* getLastComment()
+char* Disas7000::getLastComment()
 {
-	return comment;
+	return comment_;
 }
 
 //	return internal byte address as label or as hex string
-char* getDataAddr ()
+char* Disas7000::getDataAddr ()
 {
-	static char addr[41];
 	unsigned x;
 	symbol_t symtofind;
 	symbol_t *sym;
 
-    addr[0] = 0;
+    dataAddr_[0] = 0;
 	x = fetch();
 
 	symtofind.val = x;
 	symtofind.seg = 'D';
 
-	sym = (symbol_t*)bsearch( &symtofind, tms7000Symbols, nTms7000Symbols, sizeof( symbol_t ), (compfptr_t)symSort );
+	sym = (symbol_t*)bsearch( &symtofind, symbols_, nSymbols_, sizeof( symbol_t ), (compfptr_t)symSort );
 
 	if (sym != NULL && sym->name[0] != 0)
 	{
-		strcpy(addr, sym->name);
-		return addr;
+		strcpy(dataAddr_, sym->name);
+		return dataAddr_;
 	}
 
-	sprintf (addr, ">%02X", x);
+	sprintf (dataAddr_, ">%02X", x);
 
-	return addr;
+	return dataAddr_;
 }
 
 
 // fetch long external address and return it as hex string or as label
-char* getLAddr()
+char* Disas7000::getLAddr()
 {
 	uint x;
-	char oldseg = pcOffsetSeg;
+	char oldseg = pcOffsetSeg_;
 	char *ret;
 
 	x = fetch () << 8;
 	x += fetch ();
-	if ( pcOffset && x + pcOffset >= pcOffsetBeg && x + pcOffset < pcOffsetEnd )
-		x += pcOffset;
+	if ( pcOffset_ && x + pcOffset_ >= pcOffsetBeg_ && x + pcOffset_ < pcOffsetEnd_ )
+		x += pcOffset_;
 	else
-		pcOffsetSeg = 'C';
+		pcOffsetSeg_ = 'C';
 	ret = getXAddr( x );
-	pcOffsetSeg = oldseg;
+	pcOffsetSeg_ = oldseg;
 	return ret;
 }
 
 // fetch short relative external address and return it as hex string or as label
-char* getSAddr()
+char* Disas7000::getSAddr()
 {
 	uint x;
 	signed char d;
 	d = (signed char) fetch ();
-	x = pc + d;
+	x = pc_ + d;
 	return getXAddr( x );
 }
 
 // return operand name or value
-const char* getOperand(int opcode, int opn)
+const char* Disas7000::getOperand(int opcode, int opn)
 {
-	static char op[41];
+	char *op = operand_;
 	unsigned x;
 
     strcpy (op, "??");
@@ -397,19 +373,19 @@ const char* getOperand(int opcode, int opn)
 }
 
 // get 1st operand name or value
-const char* getOperand1(int opcode)
+const char* Disas7000::getOperand1(int opcode)
 {
 	return getOperand(opcode, instrTable[opcode].opn1);
 }
 
 // get 2nd operand name or value
-const char* getOperand2(int opcode)
+const char* Disas7000::getOperand2(int opcode)
 {
 	return getOperand(opcode, instrTable[opcode].opn2);
 }
 
 // add comment if any
-void addComment( char *src, int size, char *pComment )
+static void addComment( char *src, int size, char *pComment )
 {
 	size_t n;
 
@@ -425,10 +401,10 @@ void addComment( char *src, int size, char *pComment )
 }
 
 // get single instruction source
-char* source ()
+char* Disas7000::source ()
 {
 	ushort opcode;
-	static char src[80];
+	char *src = src_;
 	size_t i;
 	const char* op;
 
@@ -441,7 +417,7 @@ char* source ()
 
 	src[i] = '\0';
 
-	comment = 0;
+	comment_ = 0;
 
 	op = getOperand1( opcode );
 	if ( op )
@@ -464,7 +440,7 @@ char* source ()
 		}
 	}
 
-	addComment( src, sizeof(src), comment );
+	addComment( src, sizeof(src_), comment_ );
 
 	for (i=strlen(src);i<48;i++) {
 		src[i] = ' ';
@@ -27,57 +27,96 @@
 #define __DISAS7000_H__
 
 #include "TMS7000CPU.h"
-
 #include "Symbols.h"
+#include "Memory_I.h"
 #include "runtime.h"
 
+typedef int (*compfptr_t)(const void*, const void*);
+
+// TMS7000 disassembler state: one per disassembler instance
+class Disas7000
+{
+public:
+	Disas7000();
 
+	// Attach TMS7000 to external symbol table
+	void setSymbols( symbol_t *pSymbols, int pNSymbols, int pSymbolsSize );
 
-typedef int (*compfptr_t)(const void*, const void*);
-typedef uchar (*readfptr_t)( ushort );
-typedef uchar (*writefptr_t)( ushort, uchar );
+	void updateSymbols();
+
+	// Attach TMS7000 to memory (reader called with object)
+	void setMemIO( Memory_I::reader_t reader, void *object );
+
+	// set PC
+	void setPC( uint pc )
+	{
+		pc_ = pc;
+	}
+
+	// get PC
+	uint getPC()
+	{
+		return pc_;
+	}
 
+	// get label of given code address
+	char* getLabel( uint val, char ds );
 
-// get label of given code address
-char* getLabel( uint val, char ds );
+	// set label generated (DS labels)
+	void setLabelGen( uint val );
 
-// set label generated (DS labels)
-void setLabelGen( uint val );
+	// get label and offset of given code address
+	char* getLabelOffset( uint val );
 
-// get label of given code address
-char* getXAddr( uint val );
+	// get label of given code address
+	char* getXAddr( uint val );
 
-// get comment associated to label of given code address from last getXAddr()/getLabel() call
-char* getLastComment();
+	// get comment associated to label of given code address from last getXAddr()/getLabel() call
+	char* getLastComment();
 
-// fetch long external address and return it as hex string or as label
-char* getLAddr();
+	// fetch long external address and return it as hex string or as label
+	char* getLAddr();
 
-// get single instruction source
-char* source();
+	// get single instruction source
+	char* source();
 
-// Z-80 simulator
-extern uint		pc;
+private:
+	char getCodeSeg();
+	uchar fetch();
+	char* getDataAddr();
+	char* getSAddr();
+	const char* getOperand( int opcode, int opn );
+	const char* getOperand1( int opcode );
+	const char* getOperand2( int opcode );
 
-extern char		noNewEqu;
+	Memory_I::reader_t	reader_;
+	void			*object_;
 
-extern uint		nTms7000Symbols;
-extern symbol_t	*tms7000Symbols;
-extern int		pcOffset;
-extern ushort	pcOffsetBeg, pcOffsetEnd;
-extern char		pcOffsetSeg;
+	char			noNewEqu_;
+	char			labelcolon_;
 
-extern instr_t instrTable[];
+	uint			pc_;
 
-// Attach TMS7000 to external symbol table
-void setTms7000Symbols( symbol_t *pSymbols, int pNSymbols, int pSymbolsSize );
+	int				pcOffset_;
+	ushort			pcOffsetBeg_, pcOffsetEnd_;
+	char			pcOffsetSeg_;
 
-void updateTms7000Symbols();
+	// Symbols table
+	symbol_t		*symbols_;
+	uint			symbolsSize_;
+	uint			nSymbols_;
+	uint			nNewSymbols_;
 
-void resetTms7000Symbols();
+	char			*comment_;
 
-// Attach TMS7000 to memory and I/O ports
-void setTms7000MemIO( readfptr_t getdata );
+	// Returned strings
+	char			label_[40];
+	char			labelOffset_[60];
+	char			xaddr_[41];
+	char			dataAddr_[41];
+	char			operand_[41];
+	char			src_[80];
+};
 
 // Sort symbols
 int  symSort(const void *a, const void *b);
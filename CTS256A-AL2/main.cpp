@@ -31,18 +31,26 @@
 #include "TMS7000CPU.h"
 #include "TMS7000DebugHelper.h"
 #include "TMS7000Disassembler.h"
+#include "cts256.h"
+#include "cts256pool.h"
 
 #include <sstream>
 #include <fstream>
+#include <cstring>
 #include <memory>
 #include <vector>
+#include <chrono>
+#include <thread>
 
 void help()
 {
 	puts(
 		"GI/Microchip CTS256A-AL2(tm) Code-To-Speech Speech Processor\n\n"
 		"Usage:\n"
-		"cts256a-al2 [-iFile] [-t] [-b] [-e] [-d] [-v] [-n] [text]\n"
+		"cts256a-al2 [-iFile] [-t] [-b] [-e] [-d] [-v] [-n] [-s] [-c] [-g[N]] [-w] [-k]\n"
+		"            [--snapshot=File] [--restore=File] [--batch|--batch0] [-j[N]]\n"
+		"            [--scaling] [--cache=N] [--native] [--verify=N] [--hle=List]\n"
+		"            [--hle-check] [--offsets] [--flush=Policy] [--watchdog] [text]\n"
 		" -iFile    Optional input filename\n"
 		" -xFile    Optional exception ROM image filename\n"
 		" -t        Select text output (allophone labels) (default)\n"
@@ -52,10 +60,36 @@ void help()
 		" -r        Rules debugging mode\n"
 		" -d        Debug mode\n"
 		" -n        Suppress 'O.K.'\n"
+		" -s        Show emulation statistics (benchmark)\n"
+		" -c        Run the ROM code recompiled to C++\n"
+		" -g[N]     Compile code run N times (default 16) to native x86-64 code\n"
+		" -w        Interpret the wait loops instead of skipping them\n"
+		" -k        Input 1 character per interrupt instead of 1 line\n"
 		" -aAddr    Start address (in hex) of exception ROM\n"
+		" --snapshot=File  Save the machine state after the init to File and exit\n"
+		" --restore=File   Start the conversion from the machine state in File\n"
+		" --batch   Convert each input line separately, output 1 line per request\n"
+		" --batch0  Same, with NUL-delimited requests\n"
+		" -j[N]     Batch mode on N threads (default: 1 per core), output in input order\n"
+		" --scaling Batch throughput on 1, 2, 4... up to N threads (-jN), output discarded\n"
+		" --cache=N Batch mode caching the allophones of N words per thread\n"
+		" --native  Batch mode converting by the rules extracted from the ROMs, without\n"
+		"           emulation when possible\n"
+		" --verify=N Check 1 in N requests converted by the cache or by the rules\n"
+		"           against the emulator\n"
+		" --hle=List Run the listed ROM subroutines natively: scan, bracket, read,\n"
+		"           all (default) or none\n"
+		" --hle-check Check each native subroutine call against the ROM code\n"
+		" --offsets Text output with the input offset (@N) of the allophones of each rule\n"
+		" --flush=Policy Flush the output after each allophone (default), word, line,\n"
+		"           or only when the buffer is full and at exit\n"
+		" --watchdog Enter the debugger when the ROM stalls, as -d, -r, -v and -e do\n"
 		" --        Stop parsing options\n"
 		" text      Optional text to convert\n"
 		"If no -iFile and no text is given, reads input from stdin.\n"
+		"-j, --scaling, --cache and --native always run the recompiled ROM code. They\n"
+		"don't support -d, -r, -v, -e, -c, -g, -w, -k, --snapshot, --restore, --offsets,\n"
+		"--watchdog.\n"
 		"Example: echo Hello World. | CTS256A-AL2.exe -n | SP0256.exe -i-\n"
 	);
 }
@@ -84,10 +118,307 @@ static bool read_rom_file(const char *filename, std::vector<uchar>& rom)
 	return true;
 }
 
+// Snapshot file: magic, format version, then the snapshot fields one by one,
+// little endian, so that the file doesn't depend on the struct layout of the
+// compiler. Bump the version when the fields change.
+static const char snapshot_magic[8] = { 'C', 'T', 'S', '2', '5', '6', 'S', 'N' };
+static const uint snapshot_version = 1;
+
+// Write an integer field of bytes bytes
+static void put_field(std::ostream& ostr, unsigned long long value, uint bytes)
+{
+	for ( uint i = 0; i < bytes; ++i )
+		ostr.put( char( value >> ( 8 * i ) ) );
+}
+
+// Read an integer field of bytes bytes
+static unsigned long long get_field(std::istream& istr, uint bytes)
+{
+	unsigned long long value = 0;
+
+	for ( uint i = 0; i < bytes; ++i )
+		value |= (unsigned long long)uchar( istr.get() ) << ( 8 * i );
+
+	return value;
+}
+
+static bool write_snapshot_file(const char *filename, const CTS256A_AL2::snapshot_t& snapshot)
+{
+	std::ofstream snapshot_file(filename, std::ios::binary);
+
+	if ( !snapshot_file.is_open() )
+	{
+		return false;
+	}
+
+	const TMS7000CPU::state_t &cpu = snapshot.cpu;
+	const CTS256A_AL2_Board_I::state_t &data = snapshot.data;
+
+	snapshot_file.write( snapshot_magic, sizeof snapshot_magic );
+	put_field( snapshot_file, snapshot_version, 4 );
+
+	// CPU; the counters are 64-bit in the file
+	snapshot_file.write( reinterpret_cast<const char*>( cpu.data ), sizeof cpu.data );
+	put_field( snapshot_file, cpu.pc, 2 );
+	put_field( snapshot_file, cpu.sp, 1 );
+	put_field( snapshot_file, cpu.st, 1 );
+	put_field( snapshot_file, cpu.iocnt0, 1 );
+	put_field( snapshot_file, cpu.iocnt1, 1 );
+	put_field( snapshot_file, cpu.irq, 1 );
+	put_field( snapshot_file, cpu.cycles, 8 );
+	put_field( snapshot_file, cpu.instructions, 8 );
+
+	// Board
+	snapshot_file.write( reinterpret_cast<const char*>( data.ram ), sizeof data.ram );
+	put_field( snapshot_file, data.bport, 1 );
+	put_field( snapshot_file, data.initctr, 1 );
+	put_field( snapshot_file, data.irq3ctr, 2 );
+	put_field( snapshot_file, data.debugctr, 4 );
+	put_field( snapshot_file, data.eofctr, 4 );
+	put_field( snapshot_file, data.eof, 1 );
+	put_field( snapshot_file, data.utterances, 4 );
+	put_field( snapshot_file, data.lastInput, 1 );
+	snapshot_file.write( reinterpret_cast<const char*>( data.initOutput ), sizeof data.initOutput );
+	put_field( snapshot_file, data.romAddress, 2 );
+	put_field( snapshot_file, data.romSize, 4 );
+	put_field( snapshot_file, data.romChecksum, 4 );
+
+	return snapshot_file.good();
+}
+
+static bool read_snapshot_file(const char *filename, CTS256A_AL2::snapshot_t& snapshot)
+{
+	std::ifstream snapshot_file(filename, std::ios::binary);
+
+	if ( !snapshot_file.is_open() )
+	{
+		return false;
+	}
+
+	char magic[sizeof snapshot_magic];
+
+	snapshot_file.read( magic, sizeof magic );
+
+	if ( !snapshot_file || memcmp( magic, snapshot_magic, sizeof magic )
+		|| get_field( snapshot_file, 4 ) != snapshot_version )
+	{
+		return false;
+	}
+
+	TMS7000CPU::state_t &cpu = snapshot.cpu;
+	CTS256A_AL2_Board_I::state_t &data = snapshot.data;
+
+	snapshot_file.read( reinterpret_cast<char*>( cpu.data ), sizeof cpu.data );
+	cpu.pc = ushort( get_field( snapshot_file, 2 ) );
+	cpu.sp = uchar( get_field( snapshot_file, 1 ) );
+	cpu.st = uchar( get_field( snapshot_file, 1 ) );
+	cpu.iocnt0 = uchar( get_field( snapshot_file, 1 ) );
+	cpu.iocnt1 = uchar( get_field( snapshot_file, 1 ) );
+	cpu.irq = uchar( get_field( snapshot_file, 1 ) );
+	cpu.cycles = ulong( get_field( snapshot_file, 8 ) );
+	cpu.instructions = ulong( get_field( snapshot_file, 8 ) );
+
+	snapshot_file.read( reinterpret_cast<char*>( data.ram ), sizeof data.ram );
+	data.bport = uchar( get_field( snapshot_file, 1 ) );
+	data.initctr = uchar( get_field( snapshot_file, 1 ) );
+	data.irq3ctr = ushort( get_field( snapshot_file, 2 ) );
+	data.debugctr = uint( get_field( snapshot_file, 4 ) );
+	data.eofctr = uint( get_field( snapshot_file, 4 ) );
+	data.eof = get_field( snapshot_file, 1 ) != 0;
+	data.utterances = uint( get_field( snapshot_file, 4 ) );
+	data.lastInput = uchar( get_field( snapshot_file, 1 ) );
+	snapshot_file.read( reinterpret_cast<char*>( data.initOutput ), sizeof data.initOutput );
+	data.romAddress = ushort( get_field( snapshot_file, 2 ) );
+	data.romSize = uint( get_field( snapshot_file, 4 ) );
+	data.romChecksum = uint( get_field( snapshot_file, 4 ) );
+
+	// Nothing may follow the fields
+	return snapshot_file.good() && snapshot_file.peek() == std::char_traits<char>::eof();
+}
+
+// Read the next batch request
+static bool read_request(std::istream& istr, std::string& text, char delimiter)
+{
+	if ( !std::getline( istr, text, delimiter ) )
+	{
+		return false;
+	}
+
+	if ( delimiter == '\n' && !text.empty() && text.back() == '\r' )
+		text.pop_back();
+
+	return true;
+}
+
+static void print_stats(ConIOConsole& console, ulong instructions, ulong cycles, uint utterances, double elapsed)
+{
+	double emulated = double( cycles ) / CTS256A_AL2_CLOCK;
+	console.printf( "Instructions: %lu\n", instructions );
+	console.printf( "Cycles:       %lu (%.3f s at %.0f MHz)\n", cycles, emulated, CTS256A_AL2_CLOCK / 1e6 );
+	console.printf( "Utterances:   %u (%.0f cycles per utterance)\n", utterances,
+		utterances ? double( cycles ) / utterances : 0.0 );
+	console.printf( "Elapsed:      %.3f s\n", elapsed );
+	console.printf( "Speed:        %.2f MIPS (%.1fx real time)\n\n",
+		elapsed > 0 ? instructions / elapsed / 1e6 : 0.0,
+		elapsed > 0 ? emulated / elapsed : 0.0 );
+}
+
+static void print_cache_stats(ConIOConsole& console, const CTS256::cacheStats_t& stats)
+{
+	uint64_t words = stats.hits + stats.misses;
+	console.printf( "Cache hits:   %llu of %llu words (%.1f%%)\n", (unsigned long long)stats.hits,
+		(unsigned long long)words, words ? 100.0 * stats.hits / words : 0.0 );
+	console.printf( "Evictions:    %llu\n", (unsigned long long)stats.evictions );
+	console.printf( "Bypassed:     %llu requests\n", (unsigned long long)stats.bypassed );
+	console.printf( "Verified:     %llu requests, %llu mismatches\n\n", (unsigned long long)stats.verified,
+		(unsigned long long)stats.mismatches );
+}
+
+// Parse the comma-separated list of the ROM subroutines run natively
+static bool parse_hle(const char *list, uint& routines)
+{
+	routines = 0;
+
+	while ( *list )
+	{
+		std::string name( list, strcspn( list, "," ) );
+
+		if ( name == "all" )
+			routines |= HLE_ALL;
+		else if ( name == "scan" )
+			routines |= HLE_SCAN;
+		else if ( name == "bracket" )
+			routines |= HLE_BRACKET;
+		else if ( name == "read" )
+			routines |= HLE_READ;
+		else if ( name != "none" )
+			return false;
+
+		list += name.size();
+		if ( *list )
+			++list;
+	}
+
+	return true;
+}
+
+static void print_hle_stats(ConIOConsole& console, const CTS256::hleStats_t& stats)
+{
+	console.printf( "HLE calls:    %llu\n", (unsigned long long)stats.calls );
+	console.printf( "HLE checks:   %llu calls, %llu mismatches\n\n", (unsigned long long)stats.checks,
+		(unsigned long long)stats.mismatches );
+}
+
+static void print_native_stats(ConIOConsole& console, const CTS256::nativeStats_t& stats)
+{
+	uint64_t requests = stats.converted + stats.bypassed;
+	console.printf( "Native:       %llu of %llu requests (%.1f%%)\n", (unsigned long long)stats.converted,
+		(unsigned long long)requests, requests ? 100.0 * stats.converted / requests : 0.0 );
+	console.printf( "Verified:     %llu requests, %llu mismatches\n\n", (unsigned long long)stats.verified,
+		(unsigned long long)stats.mismatches );
+}
+
+// Output of the parallel batch mode
+struct batch_output_t
+{
+	std::ostream	*ostr;
+	char			mode;
+	uint			stalled;
+	bool			flush;			///< after each request
+};
+
+// Parse the output flush policy
+static bool parse_flush(const char *policy, uint& flush)
+{
+	if ( !strcmp( policy, "allophone" ) )
+		flush = FLUSH_ALLOPHONE;
+	else if ( !strcmp( policy, "word" ) )
+		flush = FLUSH_WORD;
+	else if ( !strcmp( policy, "line" ) )
+		flush = FLUSH_LINE;
+	else if ( !strcmp( policy, "exit" ) )
+		flush = FLUSH_EXIT;
+	else
+		return false;
+
+	return true;
+}
+
+// Write the allophones of a request as 1 line, as the batch mode does
+static void write_batch_result(void *object, const std::vector<uchar>& allophones, bool ok)
+{
+	batch_output_t *output = (batch_output_t*)object;
+
+	for ( uchar allophone : allophones )
+	{
+		if ( output->mode == 'T' )
+			*output->ostr << " " << CTS256::getLabel( allophone );
+		else
+			output->ostr->put( allophone | 0x80 );
+	}
+
+	output->ostr->put( '\n' );
+	if ( output->flush )
+		output->ostr->flush();
+
+	if ( !ok )
+		++output->stalled;
+}
+
+// Scaling benchmark: convert the batch requests on 1, 2, 4... up to
+// max_threads workers, and compare the throughputs
+static void batch_scaling(ConIOConsole& console, const std::vector<std::string>& requests,
+	uint max_threads, const std::vector<uchar>& exception_rom, ushort rom_address,
+	size_t cache_entries, bool native, uint verify, uint hle)
+{
+	std::ostringstream sink;
+	double base = 0.0;
+
+	console.printf( "%u requests, %u hardware threads\n\n", uint( requests.size() ),
+		std::thread::hardware_concurrency() );
+	console.printf( "Threads   Elapsed   Requests/s      MIPS   Speedup   Efficiency\n" );
+
+	for ( uint threads = 1; ; threads = threads * 2 < max_threads ? threads * 2 : max_threads )
+	{
+		batch_output_t output = { &sink, 'B', 0, false };
+
+		auto start = std::chrono::steady_clock::now();
+
+		CTS256Pool pool( threads, write_batch_result, &output, exception_rom, rom_address );
+		pool.setCache( cache_entries, verify );
+		pool.setNative( native, verify );
+		pool.setHLE( hle );
+
+		for ( const std::string &text : requests )
+			pool.translate( std::string( text ) );
+
+		pool.finish();
+		pool.stop();
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		if ( threads == 1 )
+			base = elapsed.count();
+
+		double speedup = base / elapsed.count();
+
+		console.printf( "%7u %9.3f %12.1f %9.2f %9.2f %11.0f%%\n", threads, elapsed.count(),
+			requests.size() / elapsed.count(), pool.getInstructions() / elapsed.count() / 1e6,
+			speedup, 100.0 * speedup / threads );
+
+		sink.str( "" );
+
+		if ( threads >= max_threads )
+			break;
+	}
+
+	console.puts( "\n" );
+}
+
 int main(int argc, char* argv[])
 {
 	char mode = 'T';
-	bool echo = false, debug = false, debug_rules = false, verbose = false, noOK = false, opts = true;
+	bool echo = false, debug = false, debug_rules = false, verbose = false, noOK = false, stats = false, recompiled = false, wait = false, charInput = false, opts = true;
 
 	std::istream *pistr = &std::cin;
 	std::ostream *postr = &std::cout;
@@ -98,6 +429,19 @@ int main(int argc, char* argv[])
 
 	std::vector<uchar> exception_rom{};
 	ushort rom_address;
+	uint jit_threshold = 0;
+	const char *snapshot_file = 0, *restore_file = 0;
+	bool batch = false, scaling = false;
+	char batch_delimiter = '\n';
+	uint jobs = 1;
+	size_t cache_entries = 0;
+	bool native = false;
+	uint verify = 0;
+	uint hle = HLE_ALL;
+	bool hle_check = false;
+	bool offsets = false;
+	uint flush = FLUSH_ALLOPHONE;
+	bool watchdog = false;
 
 	ConIOConsole console;
 	console.puts( NAME " - " VERSION "\n\n" );
@@ -179,8 +523,85 @@ int main(int argc, char* argv[])
 			case 'N': // No OK
 				noOK = 1;
 				break;
-			case '-': // End opts
-				opts = false;
+			case 'S': // Statistics
+				stats = 1;
+				break;
+			case 'C': // Recompiled ROM code
+				recompiled = 1;
+				break;
+			case 'G': // Native code (JIT)
+				++s;
+				jit_threshold = *s ? atoi( s ) : 16;
+				if ( jit_threshold == 0 )
+					jit_threshold = 1;
+				break;
+			case 'W': // Interpret wait loops
+				wait = 1;
+				break;
+			case 'K': // Input by character
+				charInput = 1;
+				break;
+			case 'J': // Parallel batch mode
+				++s;
+				jobs = *s ? atoi( s ) : 0;
+				batch = true;
+				break;
+			case '-': // End opts, or long option
+				if ( !strncmp( s, "-snapshot=", 10 ) )
+					snapshot_file = s + 10;
+				else if ( !strncmp( s, "-restore=", 9 ) )
+					restore_file = s + 9;
+				else if ( !strcmp( s, "-batch" ) )
+					batch = true;
+				else if ( !strcmp( s, "-batch0" ) )
+				{
+					batch = true;
+					batch_delimiter = '\0';
+				}
+				else if ( !strcmp( s, "-scaling" ) )
+					scaling = true;
+				else if ( !strncmp( s, "-cache=", 7 ) )
+				{
+					cache_entries = strtoul( s + 7, nullptr, 10 );
+					batch = true;
+				}
+				else if ( !strcmp( s, "-native" ) )
+				{
+					native = true;
+					batch = true;
+				}
+				else if ( !strncmp( s, "-verify=", 8 ) )
+					verify = atoi( s + 8 );
+				else if ( !strncmp( s, "-hle=", 5 ) )
+				{
+					if ( !parse_hle( s + 5, hle ) )
+					{
+						console.printf( "Unrecognized ROM subroutines: %s\n", s + 5 );
+						return 1;
+					}
+				}
+				else if ( !strcmp( s, "-hle-check" ) )
+					hle_check = true;
+				else if ( !strcmp( s, "-offsets" ) )
+					offsets = true;
+				else if ( !strcmp( s, "-watchdog" ) )
+					watchdog = true;
+				else if ( !strncmp( s, "-flush=", 7 ) )
+				{
+					if ( !parse_flush( s + 7, flush ) )
+					{
+						console.printf( "Unrecognized flush policy: %s\n", s + 7 );
+						return 1;
+					}
+				}
+				else if ( !s[1] )
+					opts = false;
+				else
+				{
+					printf( "Unrecognized switch: -%s\n", s );
+					printf( "sp0256 -? for help.\n" );
+					return 1;
+				}
 				break;
 			case '?': // Help
 				help();
@@ -202,19 +623,194 @@ int main(int argc, char* argv[])
 
 	std::cin.sync_with_stdio();
 
-	CTS256A_AL2 system( *pistr, *postr, std::move( exception_rom ), rom_address );
+	if ( hle_check )
+		hle |= HLE_CHECK;
+
+	// Parallel batch mode: a pool of CTS256 instances, without console
+	if ( jobs != 1 || scaling || cache_entries || native )
+	{
+		// The pool instances always run the recompiled ROM code, with the
+		// default wait loop and input handling
+		if ( debug || debug_rules || verbose || echo || recompiled || jit_threshold || wait || charInput
+			|| snapshot_file || restore_file || offsets || watchdog )
+		{
+			console.printf( "-j, --scaling, --cache and --native don't support -d, -r, -v, -e, -c, -g, -w, -k,\n"
+				"--snapshot, --restore, --offsets and --watchdog\n" );
+			return 1;
+		}
+
+		if ( scaling )
+		{
+			std::vector<std::string> requests;
+			std::string text;
+
+			while ( read_request( *pistr, text, batch_delimiter ) )
+				requests.push_back( text );
+
+			uint max_threads = jobs > 1 ? jobs : std::thread::hardware_concurrency();
+			batch_scaling( console, requests, max_threads ? max_threads : 1, exception_rom, rom_address,
+				cache_entries, native, verify, hle );
+			return 0;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+
+		batch_output_t output = { postr, mode, 0, flush != FLUSH_EXIT };
+		CTS256Pool pool( jobs, write_batch_result, &output, exception_rom, rom_address );
+		pool.setCache( cache_entries, verify );
+		pool.setNative( native, verify );
+		pool.setHLE( hle );
+		std::string text;
+
+		while ( read_request( *pistr, text, batch_delimiter ) )
+			pool.translate( std::move( text ) );
+
+		pool.finish();
+		pool.stop();
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		if ( output.stalled )
+			console.printf( "%u requests stalled\n", output.stalled );
+
+		console.puts( "Conversion complete.\n\n" );
+
+		if ( stats )
+		{
+			console.printf( "Threads:      %u\n", pool.getThreads() );
+			print_stats( console, pool.getInstructions(), pool.getCycles(), uint( pool.getUtterances() ), elapsed.count() );
+
+			if ( cache_entries )
+				print_cache_stats( console, pool.getCacheStats() );
+
+			if ( native )
+				print_native_stats( console, pool.getNativeStats() );
+
+			if ( hle )
+				print_hle_stats( console, pool.getHLEStats() );
+		}
+
+		return output.stalled ? 1 : 0;
+	}
+
+	// Batch mode: the requests are read from the input, and converted one
+	// by one from the request stream
+	std::stringstream request;
+
+	// The debug watchdog and the traces only run on the diagnostic board
+	std::unique_ptr<CTS256A_AL2> system( CTS256A_AL2::create( debug || debug_rules || verbose || echo || watchdog,
+		batch ? request : *pistr, *postr, std::move( exception_rom ), rom_address ) );
+
+	system->setOption( 'D', debug );
+	system->setOption( 'E', echo );
+	system->setOption( 'V', verbose );
+	system->setOption( 'R', debug_rules );
+	system->setOption( 'N', noOK || batch );
+	system->setOption( 'M', mode );
+	system->setOption( 'C', recompiled );
+	system->setOption( 'G', jit_threshold );
+	system->setOption( 'W', wait );
+	system->setOption( 'K', charInput );
+	system->setOption( 'H', hle );
+	system->setOption( 'O', offsets );
+	system->setOption( 'F', flush );
+
+	if ( snapshot_file )
+	{
+		CTS256A_AL2::snapshot_t snapshot;
+
+		system->boot();
+		system->getSnapshot( snapshot );
+
+		if ( !write_snapshot_file( snapshot_file, snapshot ) )
+		{
+			console.printf( "Failed to write %s\n", snapshot_file );
+			return 1;
+		}
+
+		console.printf( "Snapshot saved to %s\n", snapshot_file );
+		return 0;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	CTS256A_AL2::snapshot_t snapshot;
+
+	if ( restore_file )
+	{
+		if ( !read_snapshot_file( restore_file, snapshot ) )
+		{
+			console.printf( "Invalid snapshot file %s\n", restore_file );
+			return 1;
+		}
+
+		if ( !system->restore( snapshot ) )
+		{
+			console.printf( "Snapshot %s taken with another exception ROM\n", restore_file );
+			return 1;
+		}
+	}
+
+	ulong instructions = 0, cycles = 0;
+	uint utterances = 0;
+
+	if ( batch )
+	{
+		// Run the init once, then restart from its snapshot for each request
+		if ( !restore_file )
+		{
+			system->boot();
+			system->getSnapshot( snapshot );
+		}
+
+		std::string text;
+
+		while ( read_request( *pistr, text, batch_delimiter ) )
+		{
+			request.clear();
+			request.str( text );
 
-	system.setOption( 'D', debug );
-	system.setOption( 'E', echo );
-	system.setOption( 'V', verbose );
-	system.setOption( 'R', debug_rules );
-	system.setOption( 'N', noOK );
-	system.setOption( 'M', mode );
+			system->restore( snapshot );
+			system->run();
 
-	system.run();
+			// 1 output line per request
+			postr->put( '\n' );
+			if ( flush != FLUSH_EXIT )
+				postr->flush();
+
+			instructions += system->getInstructions() - snapshot.cpu.instructions;
+			cycles += system->getCycles() - snapshot.cpu.cycles;
+			utterances += system->getUtterances() - snapshot.data.utterances;
+		}
+	}
+	else
+	{
+		system->run();
+
+		// End the text output with a new line
+		if ( mode == 'T' )
+			postr->put( '\n' );
+
+		instructions = system->getInstructions();
+		cycles = system->getCycles();
+		utterances = system->getUtterances();
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
 	console.puts( "Conversion complete.\n\n" );
 
+	if ( stats )
+	{
+		print_stats( console, instructions, cycles, utterances, elapsed.count() );
+
+		if ( hle )
+		{
+			const CTS256A_AL2_HLE &routines = system->getHLE();
+			print_hle_stats( console, { routines.getCalls(), routines.getChecks(), routines.getMismatches() } );
+		}
+	}
+
 	return 0;
 }
 
@@ -48,13 +48,8 @@
 
 FILE *readfile(const char *prompt, const char *mode);
 
-char data[0x10000];
-
-range_t ranges[1000];
-unsigned nranges = 0;
-
 // Data Write Routine (memory address space)
-unsigned char putdata(unsigned short addr, unsigned char byte)
+unsigned char Mem7000::putdata(unsigned short addr, unsigned char byte)
 {
 	// M1 System RAM
 	data[addr] = byte;
@@ -70,7 +65,7 @@ unsigned char putdata(unsigned short addr, unsigned char byte)
 }
 
 // TRS-80 Data Read Routine (memory address space)
-unsigned char getdata(unsigned short addr)
+unsigned char Mem7000::getdata(unsigned short addr)
 {
 	unsigned char byte;
 
@@ -34,14 +34,26 @@ typedef struct
 	unsigned int beg, end;
 } range_t;
 
-extern range_t ranges[];
-extern unsigned nranges;
+// Memory image, with the ranges of the written addresses
+class Mem7000
+{
+public:
+	Mem7000() : nranges( 0 )
+	{
+	}
+
+	// Data Write Routine (memory address space)
+	unsigned char putdata( unsigned short addr, unsigned char byte );
+
+	// Data Read Routine (memory address space)
+	unsigned char getdata( unsigned short addr );
 
-// Data Write Routine (memory address space)
-unsigned char putdata( unsigned short addr, unsigned char byte );
+	range_t		ranges[1000];
+	unsigned	nranges;
 
-// Data Read Routine (memory address space)
-unsigned char getdata( unsigned short addr );
+private:
+	char		data[0x10000];
+};
 
 
 #endif
@@ -0,0 +1,662 @@
+/*
+    CTS256A-AL2 - TMS7000 ROM Static Recompiler.
+
+    Created by Michel Bernard (michel_bernard@hotmail.com)
+    - <http://www.github.com/GmEsoft/SP0256_CTS256A-AL2>
+    Copyright (c) 2023 Michel Bernard.
+    All rights reserved.
+
+
+    This file is part of SP0256_CTS256A-AL2.
+
+    SP0256_CTS256A-AL2 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SP0256_CTS256A-AL2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SP0256_CTS256A-AL2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Build-time tool: translates the CTS256A-AL2 ROM into C++ code.
+//
+// The blocks reachable from the interrupt vectors through static jumps,
+// calls and traps are emitted as member functions of the board's core, with
+// the semantics of the opcode handlers inlined and their operands folded to
+// constants. A block extends over the conditional jumps not taken, up to the
+// next unconditional branch; the instructions, cycles and opcode fetches are
+// accounted at its exits by TMS7000CPU::leave(), which also takes the
+// interrupts. The opcode fetches are also accounted before each bus access,
+// so that the board sees its reads in order.
+//
+// Code only reachable through indirect jumps (BR *Rn, jump tables), the
+// instructions not implemented and the idle loops are left to the interpreter.
+
+#define _CRT_SECURE_NO_WARNINGS 1
+
+#include "TMS7000Ops.h"
+#include "CTS256A_AL2_ROM.h"
+#include "disas7000.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <set>
+#include <string>
+#include <vector>
+
+#define ROM_BASE	0xF000
+#define ROM_SIZE	0x1000
+
+// Read the ROM image as seen by the emulated CPU
+static uchar getRom( ushort addr )
+{
+	return addr >= ROM_BASE ? CTS256A_AL2_readRom( addr ) : 0xFF;
+}
+
+// ROM reader for the disassembler
+static uchar romAccessor( void * /*object*/, ushort addr )
+{
+	return getRom( addr );
+}
+
+// Get ROM word (big endian)
+static ushort getRomWord( ushort addr )
+{
+	return ( getRom( addr ) << 8 ) | getRom( addr + 1 );
+}
+
+// Format a string
+static std::string format( const char *fmt, ... )
+{
+	char text[256];
+	va_list args;
+
+	va_start( args, fmt );
+	vsnprintf( text, sizeof text, fmt, args );
+	va_end( args );
+
+	return text;
+}
+
+// Get the statically known successors of the instruction at addr
+static void successors( ushort addr, std::vector<uint> &next )
+{
+	uchar opcode = getRom( addr );
+	const instr_t &instr = TMS7000CPU::instrTable[opcode];
+	uint size = TMS7000CPU::instrSize( opcode );
+	uint fall = addr + size;
+
+	switch ( instr.mnemon )
+	{
+	case JMP:
+		next.push_back( ushort( fall + (signed char)getRom( fall - 1 ) ) );
+		break;
+	case JN:	case JZ:	case JC:	case JP:	case JPZ:	case JNZ:	case JNC:
+	case DJNZ:	case BTJO:	case BTJOP:	case BTJZ:	case BTJZP:
+		next.push_back( ushort( fall + (signed char)getRom( fall - 1 ) ) );
+		next.push_back( fall );
+		break;
+	case BR:
+		if ( instr.opn1 == ADDR )
+			next.push_back( getRomWord( addr + 1 ) );
+		break;
+	case CALL:
+		if ( instr.opn1 == ADDR )
+			next.push_back( getRomWord( addr + 1 ) );
+		next.push_back( fall );
+		break;
+	case TRAP:
+		next.push_back( getRomWord( 0xFFFE - ( ( 0xFF - opcode ) << 1 ) ) );
+		next.push_back( fall );
+		break;
+	case RETI:	case RETS:	case IDLE:	case DB:
+		break;
+	default:
+		next.push_back( fall );
+		break;
+	}
+}
+
+// Check if an instruction is a conditional jump (may fall through)
+static bool isConditional( uchar opcode )
+{
+	switch ( TMS7000CPU::instrTable[opcode].mnemon )
+	{
+	case JN:	case JZ:	case JC:	case JP:	case JPZ:	case JNZ:	case JNC:
+	case DJNZ:	case BTJO:	case BTJOP:	case BTJZ:	case BTJZP:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Find the start addresses of all statically reachable basic blocks
+static std::set<uint> findBlocks()
+{
+	std::set<uint> blocks;
+	std::vector<uint> todo;
+
+	// Interrupt and reset vectors
+	for ( uint vector = 0xFFF4; vector <= 0xFFFE; vector += 2 )
+		todo.push_back( getRomWord( vector ) );
+
+	while ( !todo.empty() )
+	{
+		uint addr = todo.back();
+		todo.pop_back();
+
+		if ( addr < ROM_BASE || !blocks.insert( addr ).second )
+			continue;
+
+		// Walk the straight-line code up to the block end
+		for ( ;; )
+		{
+			uchar opcode = getRom( addr );
+			uint size = TMS7000CPU::instrSize( opcode );
+
+			if ( addr + size > ROM_BASE + ROM_SIZE )
+				break;
+
+			if ( TMS7000CPU::isBranch( opcode ) )
+			{
+				successors( addr, todo );
+				break;
+			}
+
+			addr += size;
+		}
+	}
+
+	return blocks;
+}
+
+// Check if the instruction at addr can be recompiled: implemented by the
+// interpreter, with a register pair operand for MOVD and DECD
+static bool isRecompilable( uint addr )
+{
+	uchar opcode = getRom( addr );
+	const instr_t &instr = TMS7000CPU::instrTable[opcode];
+
+	switch ( instr.mnemon )
+	{
+	case ADC:	case ADD:	case AND:	case ANDP:	case BTJO:	case BTJZ:
+	case BR:	case CALL:	case CLR:	case CMP:	case CMPA:	case DEC:
+	case EINT:	case INC:	case JMP:	case JN:	case JZ:	case JP:
+	case JPZ:	case JNZ:	case JNC:	case LDA:	case LDSP:	case MOV:
+	case MPY:	case OR:	case ORP:	case POP:	case PUSH:	case RETI:
+	case RETS:	case RRC:	case SBB:	case STA:	case SUB:	case SWAP:
+	case TSTA:
+		return true;
+	case MOVP:
+		return instr.opn1 == PN || instr.opn2 == PN;
+	case DECD:
+		return instr.opn1 == B || ( instr.opn1 == RN && getRom( addr + 1 ) );
+	case MOVD:
+		return instr.opn2 == RN && getRom( addr + TMS7000CPU::instrSize( opcode ) - 1 )
+			&& ( instr.opn1 != RN || getRom( addr + 1 ) );
+	default:
+		return false;
+	}
+}
+
+// Recompiled block being emitted
+struct block_t
+{
+	std::string		code;
+	uint			count;					///< instructions
+	uint			cycles;					///< cycles of the instructions
+	uint			fetched;				///< opcode fetches accounted
+	bool			res;					///< uses the res variable
+	bool			word;					///< uses the word variable
+};
+
+// Emit a line of code, indented by indent tabs
+static void emit( block_t &block, const std::string &line, uint indent = 1 )
+{
+	block.code.append( indent, '\t' );
+	block.code += line;
+	block.code += '\n';
+}
+
+// Get the code of an exit of the block to pc, with extra cycles (taken jump)
+static std::string leave( const block_t &block, const std::string &pc, uint extra = 0 )
+{
+	return format( "return leave( %s, %u, %u, %u );",
+		pc.c_str(), block.count, block.cycles + extra, block.count - block.fetched );
+}
+
+// Emit the accounting of the pending opcode fetches, before a bus access
+static void sync( block_t &block )
+{
+	if ( block.fetched < block.count )
+		emit( block, format( "fetched( %u );", block.count - block.fetched ) );
+	block.fetched = block.count;
+}
+
+// Get the C++ expression of an operand at addr, and skip its bytes
+static std::string operand( int opn, uint &addr )
+{
+	uchar byte = getRom( addr );
+	ushort word = getRomWord( addr );
+
+	switch ( opn )
+	{
+	case A:
+		return "data[0]";
+	case B:
+		return "data[1]";
+	case RN:
+		++addr;
+		return format( "data[%u]", byte );
+	case PN:
+	case BYTE:
+		++addr;
+		return format( "0x%02X", byte );
+	case WORD:
+	case ADDR:
+		addr += 2;
+		return format( "0x%04X", word );
+	case WORD_B:
+	case ADDR_B:
+		addr += 2;
+		return format( "ushort( 0x%04X + data[1] )", word );
+	case ATRN:
+		++addr;
+		return format( "ushort( ( data[%u] << 8 ) + data[%u] )", uchar( byte - 1 ), byte );
+	default:
+		return "";
+	}
+}
+
+// Emit the code of the instruction at addr. Returns false if it ends the block.
+static bool emitInstruction( block_t &block, uint addr, const std::string &comment )
+{
+	uchar opcode = getRom( addr );
+	const instr_t &instr = TMS7000CPU::instrTable[opcode];
+	uint size = TMS7000CPU::instrSize( opcode );
+	uint next = addr + size;
+	uint opnd = addr + 1;
+	std::string src = operand( instr.opn1, opnd );
+	std::string dst = operand( instr.opn2, opnd );
+	std::string target = format( "0x%04X", ushort( next + (signed char)getRom( next - 1 ) ) );
+	const char *cond = 0;
+
+	// The opcode fetch is accounted with the instruction
+	emit( block, "// " + comment );
+	++block.count;
+	block.cycles += instrCycles( instr.mnemon, instr.opn1, instr.opn2 );
+
+	// External memory access: the fetches are accounted before, and the
+	// board may raise an event or change the mode
+	bool external = false;
+	if ( instr.mnemon == LDA || instr.mnemon == STA || instr.mnemon == CMPA )
+	{
+		external = instr.opn1 != ADDR || getRomWord( addr + 1 ) >= 0x100;
+		if ( external )
+			sync( block );
+	}
+
+	switch ( instr.mnemon )
+	{
+	case ADC:
+	case ADD:
+		emit( block, format( "res = %s + %s%s;", dst.c_str(), src.c_str(),
+			instr.mnemon == ADC ? " + getc()" : "" ) );
+		emit( block, format( "%s = uchar( res );", dst.c_str() ) );
+		emit( block, format( "setcnz( res >> 8, %s, %s );", dst.c_str(), dst.c_str() ) );
+		block.res = true;
+		break;
+	case SUB:
+	case SBB:
+	case CMP:
+		emit( block, format( "res = %s - %s%s;", dst.c_str(), src.c_str(),
+			instr.mnemon == SBB ? " - 1 + getc()" : "" ) );
+		if ( instr.mnemon != CMP )
+			emit( block, format( "%s = uchar( res );", dst.c_str() ) );
+		emit( block, "setcnz( ( res >> 8 ) ^ 1, uchar( res ), res );" );
+		block.res = true;
+		break;
+	case AND:
+	case OR:
+		emit( block, format( "%s %s= %s;", dst.c_str(), instr.mnemon == AND ? "&" : "|", src.c_str() ) );
+		emit( block, format( "setcnz( 0, %s, %s );", dst.c_str(), dst.c_str() ) );
+		break;
+	case MOV:
+		emit( block, format( "%s = %s;", dst.c_str(), src.c_str() ) );
+		emit( block, format( "setcnz( 0, %s, %s );", dst.c_str(), dst.c_str() ) );
+		break;
+	case MPY:
+		emit( block, format( "res = %s * %s;", src.c_str(), dst.c_str() ) );
+		emit( block, "data[0] = uchar( res >> 8 );" );
+		emit( block, "data[1] = uchar( res );" );
+		emit( block, "setcnz( 0, data[0], data[0] );" );
+		block.res = true;
+		break;
+	case CLR:
+		emit( block, format( "%s = 0;", src.c_str() ) );
+		emit( block, "setcnz( 0, 0, 0 );" );
+		break;
+	case INC:
+		emit( block, format( "++%s;", src.c_str() ) );
+		emit( block, format( "setcnz( %s == 0, %s, %s );", src.c_str(), src.c_str(), src.c_str() ) );
+		break;
+	case DEC:
+		emit( block, format( "--%s;", src.c_str() ) );
+		emit( block, format( "setcnz( %s != 0xFF, %s, %s );", src.c_str(), src.c_str(), src.c_str() ) );
+		break;
+	case SWAP:
+		emit( block, format( "%s = uchar( ( %s >> 4 ) | ( %s << 4 ) );", src.c_str(), src.c_str(), src.c_str() ) );
+		emit( block, format( "setcnz( %s & 1, %s, %s );", src.c_str(), src.c_str(), src.c_str() ) );
+		break;
+	case RRC:
+		emit( block, format( "res = %s;", src.c_str() ) );
+		emit( block, format( "%s = uchar( ( res >> 1 ) | ( getc() << 7 ) );", src.c_str() ) );
+		emit( block, format( "setcnz( res & 1, %s, %s );", src.c_str(), src.c_str() ) );
+		block.res = true;
+		break;
+	case DECD:
+	{
+		uint n = instr.opn1 == B ? 1 : getRom( addr + 1 );
+		emit( block, format( "if ( --data[%u] == 0xFF )", n ) );
+		emit( block, "{" );
+		emit( block, format( "\t--data[%u];", n - 1 ) );
+		emit( block, format( "\tsetc( data[%u] != 0xFF );", n - 1 ) );
+		emit( block, "}" );
+		emit( block, format( "setnz( data[%u], data[%u] );", n - 1, n - 1 ) );
+		break;
+	}
+	case TSTA:
+		emit( block, "setcnz( 0, data[0], data[0] );" );
+		break;
+	case LDSP:
+		emit( block, "sp = data[1];" );
+		break;
+	case PUSH:
+		emit( block, format( "data[++sp] = %s;", instr.opn1 == ST ? "getst()" : src.c_str() ) );
+		break;
+	case POP:
+		if ( instr.opn1 == ST )
+		{
+			// As the interpreter: the popped byte is dropped, and the I flag
+			// is evaluated
+			emit( block, "--sp;" );
+			emit( block, "intevent_ = true;" );
+			emit( block, leave( block, format( "0x%04X", next ) ) );
+			return false;
+		}
+		emit( block, format( "%s = data[sp--];", src.c_str() ) );
+		break;
+	case EINT:
+		emit( block, "setst( getst() | 0xF0 );" );
+		emit( block, "intevent_ = true;" );
+		emit( block, leave( block, format( "0x%04X", next ) ) );
+		return false;
+	case MOVD:
+	{
+		uint n = getRom( next - 1 );
+		if ( instr.opn1 == WORD )
+		{
+			uchar hi = getRom( addr + 1 ), lo = getRom( addr + 2 );
+			emit( block, format( "data[%u] = 0x%02X;", n - 1, hi ) );
+			emit( block, format( "data[%u] = 0x%02X;", n, lo ) );
+			emit( block, format( "setcnz( 0, 0x%02X, 0x%02X );", hi, hi ) );
+			break;
+		}
+		if ( instr.opn1 == RN )
+		{
+			uint s = getRom( addr + 1 );
+			emit( block, format( "word = ushort( ( data[%u] << 8 ) | data[%u] );", s - 1, s ) );
+		}
+		else
+		{
+			emit( block, format( "word = %s;", src.c_str() ) );
+		}
+		emit( block, format( "data[%u] = uchar( word >> 8 );", n - 1 ) );
+		emit( block, format( "data[%u] = uchar( word );", n ) );
+		emit( block, format( "setcnz( 0, data[%u], data[%u] );", n - 1, n - 1 ) );
+		block.word = true;
+		break;
+	}
+	case LDA:
+		emit( block, format( "data[0] = readMemory( %s );", src.c_str() ) );
+		emit( block, "setcnz( 0, data[0], data[0] );" );
+		break;
+	case STA:
+		emit( block, format( "writeMemory( %s, data[0] );", src.c_str() ) );
+		emit( block, "setcnz( 0, data[0], data[0] );" );
+		break;
+	case CMPA:
+		emit( block, format( "res = data[0] - readMemory( %s );", src.c_str() ) );
+		emit( block, "setcnz( ( res >> 8 ) ^ 1, uchar( res ), res );" );
+		block.res = true;
+		break;
+	case MOVP:
+		if ( instr.opn1 == PN )
+		{
+			emit( block, format( "%s = indata( %s );", dst.c_str(), src.c_str() ) );
+			emit( block, format( "setcnz( 0, %s, %s );", dst.c_str(), dst.c_str() ) );
+		}
+		else
+		{
+			emit( block, format( "setcnz( 0, %s, %s );", src.c_str(), src.c_str() ) );
+			emit( block, format( "outdata( %s, %s );", dst.c_str(), src.c_str() ) );
+		}
+		emit( block, "if ( intevent_ )" );
+		emit( block, leave( block, format( "0x%04X", next ) ), 2 );
+		break;
+	case ANDP:
+	case ORP:
+		emit( block, format( "res = indata( %s ) %s %s;", dst.c_str(), instr.mnemon == ANDP ? "&" : "|", src.c_str() ) );
+		emit( block, format( "outdata( %s, uchar( res ) );", dst.c_str() ) );
+		emit( block, format( "setcnz( 0, uchar( res ), %s );", dst.c_str() ) );
+		emit( block, "if ( intevent_ )" );
+		emit( block, leave( block, format( "0x%04X", next ) ), 2 );
+		block.res = true;
+		break;
+	case BTJO:
+		emit( block, format( "if ( %s & %s )", src.c_str(), dst.c_str() ) );
+		emit( block, leave( block, target, 2 ), 2 );
+		break;
+	case BTJZ:
+		emit( block, format( "if ( %s & ~%s )", src.c_str(), dst.c_str() ) );
+		emit( block, leave( block, target, 2 ), 2 );
+		break;
+	case JN:	cond = "getn()";					break;
+	case JZ:	cond = "getz()";					break;
+	case JP:	cond = "!getn() && !getz()";		break;
+	case JPZ:	cond = "!getn()";					break;
+	case JNZ:	cond = "!getz()";					break;
+	case JNC:	cond = "!getc()";					break;
+	case JMP:
+		emit( block, leave( block, target ) );
+		return false;
+	case BR:
+		emit( block, leave( block, src ) );
+		return false;
+	case CALL:
+		if ( instr.opn1 != ADDR )
+		{
+			emit( block, format( "word = %s;", src.c_str() ) );
+			src = "word";
+			block.word = true;
+		}
+		emit( block, format( "data[++sp] = 0x%02X;", next >> 8 ) );
+		emit( block, format( "data[++sp] = 0x%02X;", next & 0xFF ) );
+		emit( block, leave( block, src ) );
+		return false;
+	case RETS:
+	case RETI:
+		emit( block, "word = data[sp--];" );
+		emit( block, "word |= data[sp--] << 8;" );
+		if ( instr.mnemon == RETI )
+		{
+			emit( block, "setst( data[sp--] );" );
+			emit( block, "intevent_ = true;" );
+		}
+		emit( block, leave( block, "word" ) );
+		block.word = true;
+		return false;
+	}
+
+	if ( cond )
+	{
+		emit( block, format( "if ( %s )", cond ) );
+		emit( block, leave( block, target, 2 ), 2 );
+	}
+
+	if ( external )
+	{
+		emit( block, "if ( intevent_ || getMode() != MODE_RUN )" );
+		emit( block, leave( block, format( "0x%04X", next ) ), 2 );
+	}
+
+	return true;
+}
+
+// Emit the member function of the block at addr. The block extends over the
+// conditional jumps not taken, up to the next unconditional branch.
+// Returns the block size in bytes, 0 if the block isn't recompiled.
+static uint emitBlock( FILE *out, Disas7000 &disas, uint addr, uint &count )
+{
+	block_t block = { "", 0, 0, 0, false, false };
+	uint start = addr;
+
+	// Leave the idle loops to the interpreter, for the fast-forward
+	uchar opnd[3] = { getRom( addr + 1 ), getRom( addr + 2 ), getRom( addr + 3 ) };
+	if ( !isRecompilable( addr ) || TMS7000CPU::isIdleLoop( getRom( addr ), opnd ) )
+		return 0;
+
+	for ( ;; )
+	{
+		uchar opcode = getRom( addr );
+		uint size = TMS7000CPU::instrSize( opcode );
+
+		// The interpreter runs what isn't recompiled
+		if ( addr + size > ROM_BASE + ROM_SIZE || !isRecompilable( addr ) )
+		{
+			emit( block, leave( block, format( "0x%04X", addr ) ) );
+			break;
+		}
+
+		// Disassembly comment, without the trailing padding
+		disas.setPC( addr );
+		std::string src = disas.source();
+		src.erase( src.find_last_not_of( ' ' ) + 1 );
+
+		bool more = emitInstruction( block, addr, format( "%04X  %s", addr, src.c_str() ) );
+
+		addr += size;
+
+		if ( !more )
+			break;
+
+		if ( TMS7000CPU::isBranch( opcode ) && !isConditional( opcode ) )
+		{
+			emit( block, leave( block, format( "0x%04X", addr ) ) );
+			break;
+		}
+	}
+
+	fprintf( out, "// %04X\n", start );
+	fprintf( out, "template<> template<>\nvoid Core::recompiled<0x%04X>()\n{\n", start );
+	if ( block.res )
+		fprintf( out, "\tushort res;\n" );
+	if ( block.word )
+		fprintf( out, "\tushort word;\n" );
+	if ( block.res || block.word )
+		fprintf( out, "\n" );
+	fprintf( out, "%s}\n\n", block.code.c_str() );
+
+	count = block.count;
+
+	return addr - start;
+}
+
+int main( int argc, char* argv[] )
+{
+	if ( argc != 2 && argc != 3 )
+	{
+		puts( "Usage: cts256a-al2-recomp OutputFile.cpp [BoardPolicy]" );
+		return 1;
+	}
+
+	// Board of the core: CTS256A_AL2_Release, or CTS256A_AL2_Diagnostic
+	const char *policy = argc == 3 ? argv[2] : "CTS256A_AL2_Release";
+
+	FILE *out = fopen( argv[1], "w" );
+	if ( !out )
+	{
+		printf( "Failed to open %s\n", argv[1] );
+		return 1;
+	}
+
+	Disas7000 disas;
+	disas.setMemIO( romAccessor, 0 );
+
+	fprintf( out,
+		"// CTS256A-AL2 ROM recompiled to C++.\n"
+		"// Generated by cts256a-al2-recomp - DO NOT EDIT.\n\n"
+		"#include \"CTS256A_AL2_Recompiled.h\"\n\n"
+		"typedef TMS7000Core<CTS256A_AL2_Data_InOut<%s>> Core;\n\n", policy );
+
+	// Blocks: start address, size, instructions
+	struct entry_t
+	{
+		uint	addr, size, count;
+	};
+
+	std::vector<entry_t> entries;
+
+	for ( uint addr : findBlocks() )
+	{
+		entry_t entry = { addr, 0, 0 };
+		entry.size = emitBlock( out, disas, addr, entry.count );
+		if ( entry.size )
+			entries.push_back( entry );
+	}
+
+	fprintf( out,
+		"// Get the recompiled block starting at addr (0=none)\n"
+		"template<>\n"
+		"const Core::recompiled_t *Core::findRecompiled( ushort addr )\n"
+		"{\n"
+		"\tstatic const recompiled_t blocks[] =\n"
+		"\t{\n" );
+
+	std::vector<uint> index( ROM_SIZE, 0 );
+
+	for ( const entry_t &entry : entries )
+	{
+		fprintf( out, "\t\t{ &Core::recompiled<0x%04X>, %u, %u },\n", entry.addr, entry.size, entry.count );
+		index[entry.addr - ROM_BASE] = uint( &entry - &entries[0] ) + 1;
+	}
+
+	fprintf( out,
+		"\t};\n\n"
+		"\t// Block number + 1 at each ROM address (0=none)\n"
+		"\tstatic const ushort index[0x%X] =\n"
+		"\t{", ROM_SIZE );
+
+	for ( uint addr = 0; addr < ROM_SIZE; ++addr )
+		fprintf( out, "%s%u,", ( addr & 0x0F ) ? " " : "\n\t\t", index[addr] );
+
+	fprintf( out,
+		"\n\t};\n\n"
+		"\tif ( addr < 0x%X || !index[addr - 0x%X] )\n"
+		"\t\treturn 0;\n\n"
+		"\treturn &blocks[index[addr - 0x%X] - 1];\n"
+		"}\n\n"
+		"// Execute the recompiled code, with the blocks lookup inlined\n"
+		"template ulong Core::runRecompiled( ulong budget );\n", ROM_BASE, ROM_BASE, ROM_BASE );
+
+	fclose( out );
+
+	printf( "%u blocks recompiled to %s\n", uint( entries.size() ), argv[1] );
+
+	return 0;
+}
@@ -0,0 +1,70 @@
+# CTS256A-AL2 emulator regression test
+#
+# Converts the same input with two emulator runs and fails if their
+# outputs differ, or with STATS if their -s instructions, cycles and
+# utterances differ.
+#
+#   cmake -DEXE_A=<cts256a-al2> [-DARGS_A=<options>] [-DEXE_B=<cts256a-al2>]
+#         [-DARGS_B=<options>] -DINPUT=<text file> [-DROM=<exception ROM>
+#         -DROM_ADDRESS=<hex>] [-DSTATS=ON] [-DEXPECT_B=<regex>] -P compare.cmake
+#
+# ARGS_A and ARGS_B are space-separated emulator options. EXE_B defaults to
+# EXE_A. ROM is loaded by both runs. EXPECT_B must match the statistics of
+# the second run, to check that it took the path under test.
+
+if(NOT EXE_A OR NOT INPUT)
+    message(FATAL_ERROR "usage: cmake -DEXE_A=<cts256a-al2> [-DARGS_A=<options>] [-DEXE_B=<cts256a-al2>] [-DARGS_B=<options>] -DINPUT=<text file> [-DROM=<exception ROM> -DROM_ADDRESS=<hex>] [-DSTATS=ON] [-DEXPECT_B=<regex>] -P compare.cmake")
+endif()
+
+if(NOT EXE_B)
+    set(EXE_B ${EXE_A})
+endif()
+
+if(ROM)
+    set(rom -x${ROM} -a${ROM_ADDRESS})
+endif()
+
+# Run the emulator: output, statistics, and the whole -s report
+function(convert exe options output stats report)
+    separate_arguments(args UNIX_COMMAND "${options}")
+    set(command ${exe} -s ${rom} ${args} -i${INPUT})
+    string(REPLACE ";" " " line "${command}")
+    message("${line}")
+    execute_process(
+        COMMAND ${command}
+        OUTPUT_VARIABLE out
+        ERROR_VARIABLE err
+        RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${exe} failed: ${result}")
+    endif()
+    # The statistics without the timings
+    string(REGEX MATCHALL "(Instructions|Cycles|Utterances):[^\n]*" counts "${err}")
+    set(${output} "${out}" PARENT_SCOPE)
+    set(${stats} "${counts}" PARENT_SCOPE)
+    set(${report} "${err}" PARENT_SCOPE)
+endfunction()
+
+convert(${EXE_A} "${ARGS_A}" output_a stats_a report_a)
+convert(${EXE_B} "${ARGS_B}" output_b stats_b report_b)
+
+if(EXPECT_B AND NOT report_b MATCHES "${EXPECT_B}")
+    message(FATAL_ERROR "the second run does not report '${EXPECT_B}':\n${report_b}")
+endif()
+
+if(output_a STREQUAL "")
+    message(FATAL_ERROR "no output")
+endif()
+
+if(NOT output_a STREQUAL output_b)
+    string(LENGTH "${output_a}" length_a)
+    string(LENGTH "${output_b}" length_b)
+    message(FATAL_ERROR "the outputs differ (${length_a} and ${length_b} bytes)")
+endif()
+
+if(STATS)
+    if(NOT stats_a STREQUAL stats_b)
+        message(FATAL_ERROR "the statistics differ:\n${stats_a}\n${stats_b}")
+    endif()
+    message("${stats_a}")
+endif()